@@ -0,0 +1,265 @@
+#include "blendconvert.h"
+#include "converter.h"
+
+struct bc_file {
+	std::unique_ptr<BlendFile> blendFile;
+	ConvertOptions options;
+	std::vector<ExtractedModel> models;
+	std::vector<std::string> pies; // written on first request, per model
+	WarningLog warnings{false};
+	std::vector<std::string> warningMessages; // of the last extraction
+	bool extracted = false;
+};
+
+static thread_local std::string lastError;
+
+// Runs function, turning exceptions into BC_ERROR with their message kept for
+// bc_get_last_error; nothing may throw across the C API
+template<typename Function>
+static bc_status guard(Function function){
+	try {
+		return function();
+	} catch(const std::exception &e) {
+		lastError = e.what();
+	} catch(...) {
+		lastError = "Unknown error";
+	}
+
+	return BC_ERROR;
+}
+
+// Copies the fields of value that the caller's version of T has, keeping its struct_size
+template<typename T>
+static void copyResult(T *result, const T &value){
+	auto size = std::min(result->struct_size, sizeof(T));
+	auto offset = sizeof(result->struct_size);
+
+	if(size > offset){
+		memcpy((char*)result + offset, (const char*)&value + offset, size - offset);
+	}
+}
+
+static bc_status extract(bc_file *file){
+	if(!file->extracted){
+		file->warnings.take();
+		file->models = extractModels(*file->blendFile, file->options);
+		file->pies.assign(file->models.size(), std::string());
+		file->warningMessages = file->warnings.take();
+		file->extracted = true;
+	}
+
+	return BC_OK;
+}
+
+int bc_get_version(void){
+	return BLENDCONVERT_VERSION;
+}
+
+const char* bc_get_last_error(void){
+	return lastError.c_str();
+}
+
+void bc_init_options(bc_options *options){
+	if(options == nullptr){
+		return;
+	}
+
+	memset(options, 0, sizeof(bc_options));
+	options->struct_size = sizeof(bc_options);
+	options->modifiers = 1;
+	options->transform_scale = 1;
+}
+
+bc_status bc_open_file(const char *path, bc_file **file){
+	if(path == nullptr || file == nullptr){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		std::unique_ptr<bc_file> result(new bc_file());
+		result->blendFile = std::unique_ptr<BlendFile>(new BlendFile(path));
+		result->options.verbose = false;
+		result->options.warnings = &result->warnings;
+		*file = result.release();
+		return BC_OK;
+	});
+}
+
+bc_status bc_open_memory(const void *data, size_t size, const char *path, bc_file **file){
+	if(data == nullptr || file == nullptr){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		std::unique_ptr<bc_file> result(new bc_file());
+		std::string contents((const char*)data, size);
+		result->blendFile = std::unique_ptr<BlendFile>(new BlendFile(path != nullptr ? path : "", contents));
+		result->options.verbose = false;
+		result->options.warnings = &result->warnings;
+		*file = result.release();
+		return BC_OK;
+	});
+}
+
+void bc_close(bc_file *file){
+	delete file;
+
+	// Libraries linked by the file are released with it
+	BlendFileCache::getShared().collect();
+}
+
+bc_status bc_extract_meshes(bc_file *file, const bc_options *options){
+	if(file == nullptr || (options != nullptr && options->struct_size < sizeof(options->struct_size))){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	// Fields the caller's version of bc_options does not have keep their defaults
+	bc_options values;
+	bc_init_options(&values);
+	if(options != nullptr){
+		memcpy(&values, options, std::min(options->struct_size, sizeof(bc_options)));
+		values.struct_size = sizeof(bc_options);
+	}
+
+	if(values.lod_count > 0 && values.lod_triangle_counts == nullptr){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		auto &converted = file->options;
+		converted.normals = values.normals != 0;
+		converted.optimizeVertexCache = values.optimize_vertex_cache != 0;
+		converted.modifiers = values.modifiers != 0;
+		converted.transform = values.transform != 0 || values.quantize_step > 0;
+		converted.transformScale = values.transform_scale;
+		converted.quantizeStep = values.quantize_step;
+		converted.lodTriangleCounts.assign(values.lod_triangle_counts, values.lod_triangle_counts + std::max(values.lod_count, 0));
+
+		file->extracted = false;
+		file->models.clear();
+		file->pies.clear();
+		file->warningMessages.clear();
+		return extract(file);
+	});
+}
+
+bc_status bc_get_mesh_count(bc_file *file, int *count){
+	if(file == nullptr || count == nullptr){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		extract(file);
+		*count = file->models.size();
+		return BC_OK;
+	});
+}
+
+bc_status bc_get_warning_count(bc_file *file, int *count){
+	if(file == nullptr || count == nullptr){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		extract(file);
+		*count = file->warningMessages.size();
+		return BC_OK;
+	});
+}
+
+bc_status bc_get_warning(bc_file *file, int index, const char **warning){
+	if(file == nullptr || warning == nullptr){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		extract(file);
+		if(index < 0 || index >= (int)file->warningMessages.size()){
+			return BC_INVALID_ARGUMENT;
+		}
+
+		*warning = file->warningMessages[index].c_str();
+		return BC_OK;
+	});
+}
+
+bc_status bc_get_mesh(bc_file *file, int mesh, bc_mesh *result){
+	if(file == nullptr || result == nullptr || result->struct_size < sizeof(result->struct_size)){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		extract(file);
+		if(mesh < 0 || mesh >= (int)file->models.size()){
+			return BC_INVALID_ARGUMENT;
+		}
+
+		auto &model = file->models[mesh];
+		bc_mesh value;
+		value.struct_size = sizeof(bc_mesh);
+		value.name = model.name.c_str();
+		value.texture = model.texture.c_str();
+		value.level_count = model.levels.size();
+		memcpy(value.bounds_minimum, model.bounds.minimum, sizeof(value.bounds_minimum));
+		memcpy(value.bounds_maximum, model.bounds.maximum, sizeof(value.bounds_maximum));
+		value.bounds_radius = model.bounds.radius;
+
+		copyResult(result, value);
+		return BC_OK;
+	});
+}
+
+bc_status bc_get_mesh_level(bc_file *file, int mesh, int level, bc_mesh_level *result){
+	if(file == nullptr || result == nullptr || result->struct_size < sizeof(result->struct_size)){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		extract(file);
+		if(mesh < 0 || mesh >= (int)file->models.size() || level < 0 || level >= (int)file->models[mesh].levels.size()){
+			return BC_INVALID_ARGUMENT;
+		}
+
+		auto &levelMesh = *file->models[mesh].levels[level];
+		bc_mesh_level value;
+		value.struct_size = sizeof(bc_mesh_level);
+		value.vertex_count = levelMesh.getVertexCount();
+		value.positions = levelMesh.positions.data();
+		value.loop_count = levelMesh.getLoopCount();
+		value.loop_vertices = levelMesh.loopVertices.data();
+		value.uvs = levelMesh.uvs.data();
+		value.loop_normals = levelMesh.loopNormals.empty() ? nullptr : levelMesh.loopNormals.data();
+		value.triangle_count = levelMesh.getTriangleCount();
+		value.triangles = levelMesh.triangles.data();
+
+		copyResult(result, value);
+		return BC_OK;
+	});
+}
+
+bc_status bc_write_pie(bc_file *file, int mesh, char *buffer, size_t capacity, size_t *size){
+	if(file == nullptr || size == nullptr || (buffer == nullptr && capacity > 0)){
+		return BC_INVALID_ARGUMENT;
+	}
+
+	return guard([&](){
+		extract(file);
+		if(mesh < 0 || mesh >= (int)file->models.size()){
+			return BC_INVALID_ARGUMENT;
+		}
+
+		// Kept, so asking for the size and then writing formats the model once
+		auto &pie = file->pies[mesh];
+		if(pie.empty()){
+			pie = formatModel(file->models[mesh], "pie", file->options);
+		}
+
+		*size = pie.size();
+		if(pie.size() > capacity){
+			return BC_BUFFER_TOO_SMALL;
+		}
+
+		memcpy(buffer, pie.data(), pie.size());
+		return BC_OK;
+	});
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// C API of libblendconvert, for converting .blend files inside other programs.
+//
+// A file is opened from a path or a memory buffer, its meshes are extracted once and
+// then read as bulk arrays or written as PIE models into buffers of the caller. Arrays
+// returned for a file point into memory owned by it; they stay valid until the file is
+// extracted again or closed. A file must not be used by two threads at once, but
+// different files can be converted concurrently.
+//
+// Structs passed in and filled in start with their size, so fields can be added in later
+// versions without breaking programs built against earlier ones. Set struct_size to the
+// sizeof of the struct before passing it; only the fields it covers are read or written.
+// A struct_size that does not cover struct_size itself is BC_INVALID_ARGUMENT.
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLENDCONVERT_VERSION 1
+
+typedef enum bc_status {
+	BC_OK = 0,
+	BC_ERROR = 1, // the file could not be read or converted, see bc_get_last_error
+	BC_INVALID_ARGUMENT = 2, // a null pointer, a struct_size too small, or a mesh or level out of range
+	BC_BUFFER_TOO_SMALL = 3 // nothing was written; the size needed was returned
+} bc_status;
+
+typedef struct bc_file bc_file;
+
+typedef struct bc_options {
+	size_t struct_size; // sizeof(bc_options), set by bc_init_options
+	int normals; // generate normals, split at sharp edges; PIE output becomes version 4
+	int optimize_vertex_cache; // reorder triangles and vertices for the vertex cache
+	int modifiers; // apply Mirror and Array modifiers, on by default
+	int transform; // apply object matrices and turn Z-up into Y-up
+	float transform_scale; // game units per meter, when transforming
+	float quantize_step; // grid for transformed positions, 0 keeps full precision
+	const int *lod_triangle_counts; // a simplified level per target triangle count
+	int lod_count;
+} bc_options;
+
+typedef struct bc_mesh {
+	size_t struct_size; // sizeof(bc_mesh), set by the caller
+	const char *name; // without Blender's two letter ID code
+	const char *texture; // as written on the PIE TEXTURE line
+	int level_count;
+	float bounds_minimum[3]; // bounds are only set when transforming
+	float bounds_maximum[3];
+	float bounds_radius;
+} bc_mesh;
+
+// One level of a mesh. Texture coordinates and normals are stored per loop (face
+// corner); triangles index loops, and loop_vertices maps loops to vertices.
+typedef struct bc_mesh_level {
+	size_t struct_size; // sizeof(bc_mesh_level), set by the caller
+	int vertex_count;
+	const float *positions; // x, y, z per vertex
+	int loop_count;
+	const int *loop_vertices;
+	const float *uvs; // u, v per loop, v pointing down the image
+	const float *loop_normals; // x, y, z per loop, null without normals
+	int triangle_count;
+	const int *triangles; // three loop indices per triangle
+} bc_mesh_level;
+
+// The BLENDCONVERT_VERSION the library was built with
+int bc_get_version(void);
+
+// The message of the last BC_ERROR on the calling thread
+const char* bc_get_last_error(void);
+
+void bc_init_options(bc_options *options);
+
+bc_status bc_open_file(const char *path, bc_file **file);
+
+// Reads a file from data, which is copied. path may be null; when given, linked
+// libraries and images with relative paths are found next to it.
+bc_status bc_open_memory(const void *data, size_t size, const char *path, bc_file **file);
+
+void bc_close(bc_file *file);
+
+// Extracts every mesh of the file, replacing those of an earlier call. options may be
+// null for the defaults. The other mesh functions extract with the defaults when this
+// was not called.
+bc_status bc_extract_meshes(bc_file *file, const bc_options *options);
+
+bc_status bc_get_mesh_count(bc_file *file, int *count);
+
+// Warnings of the last extraction, such as modifiers that could not be applied. The
+// library prints nothing; the strings are owned by the file like the mesh arrays.
+bc_status bc_get_warning_count(bc_file *file, int *count);
+
+bc_status bc_get_warning(bc_file *file, int index, const char **warning);
+
+// Fills result, whose struct_size must be set
+bc_status bc_get_mesh(bc_file *file, int mesh, bc_mesh *result);
+
+// Fills result like bc_get_mesh
+bc_status bc_get_mesh_level(bc_file *file, int mesh, int level, bc_mesh_level *result);
+
+// Writes a mesh with all its levels as a PIE model. size receives the length of the
+// model; when it exceeds capacity, BC_BUFFER_TOO_SMALL is returned and nothing is
+// written, so a null buffer with capacity 0 asks for the size. The model is not
+// terminated with a null character.
+bc_status bc_write_pie(bc_file *file, int mesh, char *buffer, size_t capacity, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
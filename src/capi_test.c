@@ -0,0 +1,233 @@
+#include "blendconvert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Converts a file through the C API, opened both from its path and from memory, and
+// checks the mesh arrays, writing PIE models into caller buffers, structs of callers
+// built against an older bc_mesh, and the BC_INVALID_ARGUMENT paths.
+
+static int failures = 0;
+
+static void check(int condition, const char *description){
+	if(!condition){
+		printf("FAIL %s\n", description);
+		failures++;
+	}
+}
+
+// Checks that every array of a level can be read up to its counts, and that loops and
+// triangles index within range
+static void checkLevel(const bc_mesh_level *level){
+	double sum = 0;
+	int i;
+
+	check(level->vertex_count > 0 && level->loop_count > 0 && level->triangle_count > 0, "a level is empty");
+	check(level->positions != NULL && level->loop_vertices != NULL && level->uvs != NULL && level->triangles != NULL, "a level lacks an array");
+	check(level->loop_normals != NULL, "a level has no normals although they were asked for");
+
+	for(i = 0; i < level->vertex_count * 3; i++){
+		sum += level->positions[i];
+	}
+	for(i = 0; i < level->loop_count; i++){
+		check(level->loop_vertices[i] >= 0 && level->loop_vertices[i] < level->vertex_count, "a loop's vertex is out of range");
+		sum += level->uvs[i * 2] + level->uvs[i * 2 + 1];
+		sum += level->loop_normals[i * 3] + level->loop_normals[i * 3 + 1] + level->loop_normals[i * 3 + 2];
+	}
+	for(i = 0; i < level->triangle_count * 3; i++){
+		check(level->triangles[i] >= 0 && level->triangles[i] < level->loop_count, "a triangle's loop is out of range");
+	}
+
+	check(sum == sum, "a level holds NaN");
+}
+
+// Extracts the meshes of file and checks them, returning the size of the first
+// mesh's PIE model
+static size_t checkFile(bc_file *file){
+	int lods[] = { 6 };
+	bc_options options;
+	bc_mesh mesh;
+	bc_mesh_level level;
+	int count = 0;
+	int i;
+	size_t size = 0;
+	size_t written = 0;
+	char *buffer;
+
+	bc_init_options(&options);
+	options.normals = 1;
+	options.lod_triangle_counts = lods;
+	options.lod_count = 1;
+
+	check(bc_extract_meshes(file, &options) == BC_OK, "bc_extract_meshes failed");
+	check(bc_get_mesh_count(file, &count) == BC_OK && count == 1, "the cube is not one mesh");
+	if(count != 1){
+		return 0;
+	}
+
+	mesh.struct_size = sizeof(mesh);
+	check(bc_get_mesh(file, 0, &mesh) == BC_OK, "bc_get_mesh failed");
+	check(mesh.struct_size == sizeof(mesh), "bc_get_mesh changed struct_size");
+	check(strcmp(mesh.name, "Cube") == 0, "the mesh is not named Cube");
+	check(mesh.level_count == 2, "the mesh does not have its simplified level");
+
+	for(i = 0; i < mesh.level_count; i++){
+		level.struct_size = sizeof(level);
+		check(bc_get_mesh_level(file, 0, i, &level) == BC_OK, "bc_get_mesh_level failed");
+		checkLevel(&level);
+		check(i == 0 ? level.triangle_count == 12 : level.triangle_count <= 6, "a level has the wrong number of triangles");
+	}
+
+	// A null buffer asks for the size; then the model is written whole, but never
+	// past the capacity given
+	check(bc_write_pie(file, 0, NULL, 0, &size) == BC_BUFFER_TOO_SMALL && size > 0, "bc_write_pie did not return the size");
+	buffer = malloc(size + 1);
+	buffer[size - 1] = buffer[size] = 'x';
+	check(bc_write_pie(file, 0, buffer, size - 1, &written) == BC_BUFFER_TOO_SMALL && written == size, "bc_write_pie wrote into a small buffer");
+	check(buffer[size - 1] == 'x', "bc_write_pie wrote past the capacity");
+	check(bc_write_pie(file, 0, buffer, size, &written) == BC_OK && written == size, "bc_write_pie failed");
+	check(strncmp(buffer, "PIE 4", 5) == 0 && buffer[size] == 'x', "bc_write_pie wrote no PIE 4 model");
+	free(buffer);
+
+	return size;
+}
+
+// A caller built against a bc_mesh that only had struct_size and name
+static void checkOlderMesh(bc_file *file){
+	struct {
+		struct {
+			size_t struct_size;
+			const char *name;
+		} mesh;
+		char after[64];
+	} older;
+	char untouched[64];
+
+	memset(&older, 0, sizeof(older));
+	memset(older.after, 0x5a, sizeof(older.after));
+	memset(untouched, 0x5a, sizeof(untouched));
+	older.mesh.struct_size = sizeof(older.mesh);
+
+	check(bc_get_mesh(file, 0, (bc_mesh*)&older.mesh) == BC_OK, "bc_get_mesh failed for an older bc_mesh");
+	check(older.mesh.struct_size == sizeof(older.mesh), "bc_get_mesh changed an older struct_size");
+	check(older.mesh.name != NULL && strcmp(older.mesh.name, "Cube") == 0, "an older bc_mesh got no name");
+	check(memcmp(older.after, untouched, sizeof(untouched)) == 0, "bc_get_mesh wrote past an older bc_mesh");
+}
+
+static void checkInvalidArguments(bc_file *file){
+	bc_options options;
+	bc_mesh mesh;
+	bc_mesh_level level;
+	bc_file *opened = NULL;
+	int count;
+	size_t size;
+	char buffer[16];
+	const char *warning;
+
+	check(bc_open_file(NULL, &opened) == BC_INVALID_ARGUMENT, "bc_open_file took a null path");
+	check(bc_open_file("cube.blend", NULL) == BC_INVALID_ARGUMENT, "bc_open_file took a null file");
+	check(bc_open_memory(NULL, 16, NULL, &opened) == BC_INVALID_ARGUMENT, "bc_open_memory took null data");
+	check(bc_open_memory(buffer, sizeof(buffer), NULL, NULL) == BC_INVALID_ARGUMENT, "bc_open_memory took a null file");
+
+	check(bc_extract_meshes(NULL, NULL) == BC_INVALID_ARGUMENT, "bc_extract_meshes took a null file");
+	bc_init_options(&options);
+	options.struct_size = 0;
+	check(bc_extract_meshes(file, &options) == BC_INVALID_ARGUMENT, "bc_extract_meshes took a struct_size of 0");
+	options.struct_size = sizeof(size_t) - 1;
+	check(bc_extract_meshes(file, &options) == BC_INVALID_ARGUMENT, "bc_extract_meshes took a struct_size below sizeof(size_t)");
+	bc_init_options(&options);
+	options.lod_count = 1;
+	check(bc_extract_meshes(file, &options) == BC_INVALID_ARGUMENT, "bc_extract_meshes took levels without triangle counts");
+
+	check(bc_get_mesh_count(NULL, &count) == BC_INVALID_ARGUMENT, "bc_get_mesh_count took a null file");
+	check(bc_get_mesh_count(file, NULL) == BC_INVALID_ARGUMENT, "bc_get_mesh_count took a null count");
+	check(bc_get_warning_count(file, NULL) == BC_INVALID_ARGUMENT, "bc_get_warning_count took a null count");
+	check(bc_get_warning(file, -1, &warning) == BC_INVALID_ARGUMENT, "bc_get_warning took index -1");
+	check(bc_get_warning(file, 0, NULL) == BC_INVALID_ARGUMENT, "bc_get_warning took a null warning");
+
+	mesh.struct_size = sizeof(mesh);
+	check(bc_get_mesh(NULL, 0, &mesh) == BC_INVALID_ARGUMENT, "bc_get_mesh took a null file");
+	check(bc_get_mesh(file, 0, NULL) == BC_INVALID_ARGUMENT, "bc_get_mesh took a null result");
+	check(bc_get_mesh(file, -1, &mesh) == BC_INVALID_ARGUMENT, "bc_get_mesh took mesh -1");
+	check(bc_get_mesh(file, 1, &mesh) == BC_INVALID_ARGUMENT, "bc_get_mesh took a mesh past the count");
+	mesh.struct_size = 0;
+	check(bc_get_mesh(file, 0, &mesh) == BC_INVALID_ARGUMENT, "bc_get_mesh took a struct_size of 0");
+	mesh.struct_size = sizeof(size_t) - 1;
+	check(bc_get_mesh(file, 0, &mesh) == BC_INVALID_ARGUMENT, "bc_get_mesh took a struct_size below sizeof(size_t)");
+
+	level.struct_size = sizeof(level);
+	check(bc_get_mesh_level(NULL, 0, 0, &level) == BC_INVALID_ARGUMENT, "bc_get_mesh_level took a null file");
+	check(bc_get_mesh_level(file, 0, 0, NULL) == BC_INVALID_ARGUMENT, "bc_get_mesh_level took a null result");
+	check(bc_get_mesh_level(file, 1, 0, &level) == BC_INVALID_ARGUMENT, "bc_get_mesh_level took a mesh past the count");
+	check(bc_get_mesh_level(file, 0, -1, &level) == BC_INVALID_ARGUMENT, "bc_get_mesh_level took level -1");
+	check(bc_get_mesh_level(file, 0, 2, &level) == BC_INVALID_ARGUMENT, "bc_get_mesh_level took a level past the count");
+	level.struct_size = 0;
+	check(bc_get_mesh_level(file, 0, 0, &level) == BC_INVALID_ARGUMENT, "bc_get_mesh_level took a struct_size of 0");
+	level.struct_size = sizeof(size_t) - 1;
+	check(bc_get_mesh_level(file, 0, 0, &level) == BC_INVALID_ARGUMENT, "bc_get_mesh_level took a struct_size below sizeof(size_t)");
+
+	check(bc_write_pie(NULL, 0, NULL, 0, &size) == BC_INVALID_ARGUMENT, "bc_write_pie took a null file");
+	check(bc_write_pie(file, 0, NULL, 0, NULL) == BC_INVALID_ARGUMENT, "bc_write_pie took a null size");
+	check(bc_write_pie(file, 0, NULL, 16, &size) == BC_INVALID_ARGUMENT, "bc_write_pie took a null buffer with a capacity");
+	check(bc_write_pie(file, 1, buffer, sizeof(buffer), &size) == BC_INVALID_ARGUMENT, "bc_write_pie took a mesh past the count");
+}
+
+int main(int argc, char **argv){
+	bc_file *file = NULL;
+	bc_file *copy = NULL;
+	FILE *input;
+	char *data;
+	long length;
+	size_t fileSize;
+	size_t copySize;
+
+	if(argc != 2){
+		printf("Usage: capi_test [cube.blend]\n");
+		return 2;
+	}
+
+	check(bc_get_version() == BLENDCONVERT_VERSION, "the library is of another version");
+	check(bc_open_file("missing.blend", &file) == BC_ERROR && strlen(bc_get_last_error()) > 0, "opening a missing file gave no error");
+
+	if(bc_open_file(argv[1], &file) != BC_OK){
+		printf("FAIL bc_open_file: %s\n", bc_get_last_error());
+		return 1;
+	}
+
+	input = fopen(argv[1], "rb");
+	if(input == NULL){
+		printf("FAIL could not read %s\n", argv[1]);
+		return 1;
+	}
+	fseek(input, 0, SEEK_END);
+	length = ftell(input);
+	fseek(input, 0, SEEK_SET);
+	data = malloc(length);
+	check(fread(data, 1, length, input) == (size_t)length, "could not read the file");
+	fclose(input);
+
+	// The data is copied, so it can be freed right away
+	check(bc_open_memory(data, length, argv[1], &copy) == BC_OK, "bc_open_memory failed");
+	free(data);
+
+	if(copy != NULL){
+		fileSize = checkFile(file);
+		copySize = checkFile(copy);
+		check(fileSize == copySize, "the file opened from memory converts differently");
+
+		checkOlderMesh(copy);
+		checkInvalidArguments(copy);
+		bc_close(copy);
+	}
+
+	bc_close(file);
+
+	if(failures){
+		printf("%i checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include "converter.h"
+
+// Extracts the meshes of one loaded file from several threads at once, for the file held
+// in memory and streamed with a small block budget, and checks every thread gets the PIE
+// models of a single threaded run. Built with -DTHREAD_SANITIZER=ON, this also catches
+// data races in the read path.
+
+static std::vector<std::string> convert(BlendFile &file){
+	ConvertOptions options;
+	options.verbose = false;
+	options.normals = true;
+	options.lodTriangleCounts = { 300 };
+
+	std::vector<std::string> result;
+	for(auto &model : extractModels(file, options)){
+		result.push_back(formatModel(model, "pie", options));
+	}
+
+	return result;
+}
+
+static bool check(BlendFile &file, const char *mode, int threadCount){
+	auto expected = convert(file);
+	std::vector<std::vector<std::string>> results(threadCount);
+	std::vector<std::string> errors(threadCount);
+	std::vector<std::thread> threads;
+
+	for(int i = 0; i < threadCount; i++){
+		threads.push_back(std::thread([&file, &results, &errors, i](){
+			try {
+				results[i] = convert(file);
+			} catch(const std::exception &e) {
+				errors[i] = e.what();
+			}
+		}));
+	}
+	for(auto &thread : threads){
+		thread.join();
+	}
+
+	bool success = true;
+	for(int i = 0; i < threadCount; i++){
+		if(!errors[i].empty()){
+			printf("FAIL %s, %s, thread %i: %s\n", file.path.c_str(), mode, i, errors[i].c_str());
+			success = false;
+		} else if(results[i] != expected){
+			printf("FAIL %s, %s, thread %i: models differ from the single threaded run\n", file.path.c_str(), mode, i);
+			success = false;
+		}
+	}
+
+	return success;
+}
+
+int main(int argc, char **argv){
+	const int threadCount = 4;
+	int failures = 0;
+
+	if(argc < 2){
+		printf("Usage: concurrency_test [files...]\n");
+		return 2;
+	}
+
+	for(int i = 1; i < argc; i++){
+		try {
+			BlendFile loaded(argv[i]);
+			failures += check(loaded, "in memory", threadCount) ? 0 : 1;
+
+			BlendFile streamed(argv[i], 1024 * 1024);
+			failures += check(streamed, "streamed", threadCount) ? 0 : 1;
+		} catch(const std::exception &e) {
+			printf("FAIL %s: %s\n", argv[i], e.what());
+			failures++;
+		}
+	}
+
+	BlendFileCache::getShared().collect();
+
+	if(failures){
+		printf("%i checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
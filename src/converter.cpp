@@ -0,0 +1,4861 @@
+#include "converter.h"
+
+unsigned long long readPointer(const char* data, int pointerSize) {
+	unsigned long long int value = 0;
+
+	auto small = static_cast<unsigned long int>(
+		static_cast<unsigned long int>(static_cast<unsigned char>(data[3])) << 24 |
+		static_cast<unsigned long int>(static_cast<unsigned char>(data[2])) << 16 | 
+		static_cast<unsigned long int>(static_cast<unsigned char>(data[1])) << 8  | 
+		static_cast<unsigned long int>(static_cast<unsigned char>(data[0]))
+	);
+
+	value = small;
+
+	if(pointerSize == 8){
+		auto big = static_cast<unsigned long long int>(
+			static_cast<unsigned long int>(static_cast<unsigned char>(data[7])) << 24 |
+			static_cast<unsigned long int>(static_cast<unsigned char>(data[6])) << 16 | 
+			static_cast<unsigned long int>(static_cast<unsigned char>(data[5])) << 8  | 
+			static_cast<unsigned long int>(static_cast<unsigned char>(data[4]))
+		);
+
+		value = big << 32 | value;
+	}
+
+	return value;
+};
+
+std::atomic<bool> MemoryTracker::tracking(false);
+std::atomic<long long> MemoryTracker::live[MEMORY_SUBSYSTEM_COUNT];
+std::atomic<long long> MemoryTracker::peak[MEMORY_SUBSYSTEM_COUNT];
+std::atomic<long long> MemoryTracker::totalLive(0);
+std::atomic<long long> MemoryTracker::totalPeak(0);
+std::atomic<long long> MemoryTracker::inputBytes(0);
+thread_local int MemoryTracker::current = MEMORY_OTHER;
+thread_local bool insideParallelFor = false;
+
+void MemoryTracker::raisePeak(std::atomic<long long> &peak, long long value){
+	auto current = peak.load(std::memory_order_relaxed);
+	while(value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)){
+	}
+}
+
+bool MemoryTracker::isTracking(){
+	return tracking.load(std::memory_order_relaxed);
+}
+
+void MemoryTracker::allocated(int subsystem, size_t size){
+	if(!tracking.load(std::memory_order_relaxed)){
+		tracking.store(true, std::memory_order_relaxed);
+	}
+
+	raisePeak(peak[subsystem], live[subsystem].fetch_add(size, std::memory_order_relaxed) + size);
+	raisePeak(totalPeak, totalLive.fetch_add(size, std::memory_order_relaxed) + size);
+}
+
+void MemoryTracker::freed(int subsystem, size_t size){
+	live[subsystem].fetch_sub(size, std::memory_order_relaxed);
+	totalLive.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void MemoryTracker::addInput(size_t size){
+	inputBytes += size;
+}
+
+long long MemoryTracker::getPeak(){
+	if(isTracking()){
+		return totalPeak;
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (long long)usage.ru_maxrss * 1024;
+}
+
+double MemoryTracker::getPeakPerInput(){
+	return inputBytes > 0 ? (double)getPeak() / inputBytes : 0;
+}
+
+void MemoryTracker::printReport(){
+	static const char *names[MEMORY_SUBSYSTEM_COUNT] = { "other", "file", "parse tree", "block bodies", "schema", "pointers", "meshes", "output" };
+	const double megabyte = 1024 * 1024;
+
+	if(isTracking()){
+		printf("Memory (live / peak MB):\n");
+		for(int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++){
+			printf("  %-14s %9.2f / %9.2f\n", names[i], live[i] / megabyte, peak[i] / megabyte);
+		}
+		printf("  %-14s %9.2f / %9.2f\n", "total", totalLive / megabyte, totalPeak / megabyte);
+	} else {
+		printf("Memory: peak resident %0.2f MB (build with TRACK_MEMORY for subsystems)\n", getPeak() / megabyte);
+	}
+
+	printf("Input: %0.2f MB, peak %0.2f MB per input MB\n", inputBytes / megabyte, getPeakPerInput());
+}
+
+MemoryScope::MemoryScope(MemorySubsystem subsystem){
+	previous = MemoryTracker::current;
+	MemoryTracker::current = subsystem;
+}
+
+MemoryScope::~MemoryScope(){
+	MemoryTracker::current = previous;
+}
+
+WarningLog::WarningLog(bool print){
+	this->print = print;
+}
+
+WarningLog& WarningLog::getShared(){
+	static WarningLog shared(true);
+	return shared;
+}
+
+void WarningLog::add(const char *format, ...){
+	char message[256];
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(message, sizeof(message), format, arguments);
+	va_end(arguments);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if(print){
+		printf("Warning: %s\n", message);
+	} else {
+		messages.push_back(message);
+	}
+}
+
+std::vector<std::string> WarningLog::take(){
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<std::string> result;
+	result.swap(messages);
+	return result;
+}
+
+BlendField::BlendField(std::string name, std::string type, int size, int offset, int arraySize, std::vector<int> dimensions){
+	this->name = name;
+	this->type = type;
+	this->size = size;
+	this->offset = offset;
+	this->arraySize = arraySize;
+	this->dimensions = dimensions;
+}
+
+BlendType::BlendType(std::string name, int size, std::vector<BlendField*> fields){
+	this->name = name;
+	this->size = size;
+
+	for(auto field : fields){
+		this->fields.push_back(std::unique_ptr<BlendField>(field));
+
+		this->fieldsByName[field->name] = field;
+	}
+}
+
+std::vector<BlendField*> BlendType::getFields(){
+	std::vector<BlendField*> result;
+	for(auto &field : fields){
+		result.push_back(&*field);
+	}
+	return result;
+}
+
+BlendField* BlendType::getField(std::string name){
+	if(!fieldsByName.count(name)){
+		throw std::runtime_error(std::string("Could not find field ") + name + " on type " + this->name);
+	}
+
+	return fieldsByName.at(name);
+}
+
+void BlendType::addPath(std::string name, BlendPath *path){
+	paths[name] = std::unique_ptr<BlendPath>(path);
+}
+
+std::vector<std::string> BlendType::getPathNames(){
+	std::vector<std::string> result;
+	for(auto &path : paths){
+		result.push_back(path.first);
+	}
+	return result;
+}
+
+BlendLocation BlendType::locate(std::string path){
+	std::string key;
+	std::vector<int> indexes;
+	key.reserve(path.size());
+
+	for(size_t i = 0; i < path.size(); i++){
+		if(path[i] != '['){
+			key += path[i];
+			continue;
+		}
+
+		auto end = path.find(']', i);
+		if(end == std::string::npos){
+			throw std::runtime_error(std::string("Missing end bracket in path ") + path);
+		}
+
+		indexes.push_back(std::stoi(path.substr(i + 1, end - i - 1)));
+		i = end;
+	}
+
+	if(!paths.count(key)){
+		throw std::runtime_error(std::string("Could not find field ") + path + " on type " + this->name);
+	}
+
+	auto blendPath = &*paths.at(key);
+
+	if(indexes.size() > blendPath->dimensions.size()){
+		throw std::runtime_error(std::string("Too many array indexes in path ") + path + " on type " + this->name);
+	}
+
+	BlendLocation result;
+	result.path = blendPath;
+	result.offset = blendPath->offset;
+	result.length = blendPath->elementSize;
+
+	for(size_t i = 0; i < indexes.size(); i++){
+		if(indexes[i] < 0 || indexes[i] >= blendPath->dimensions[i]){
+			throw std::runtime_error(std::string("Array index out of range in path ") + path + " on type " + this->name);
+		}
+
+		result.offset += indexes[i] * blendPath->strides[i];
+	}
+	for(size_t i = indexes.size(); i < blendPath->dimensions.size(); i++){
+		result.length *= blendPath->dimensions[i];
+	}
+
+	return result;
+}
+
+int BlendType::getOffset(std::string path){
+	return locate(path).offset;
+}
+
+bool BlendType::hasPath(std::string path){
+	return paths.count(path.substr(0, path.find('['))) > 0;
+}
+
+TypeProvider::TypeProvider(blender_blend_t &data){
+	pointerSize = data.hdr()->psize();
+
+	for(auto &block : *data.blocks()){
+		if(block->code() != "DNA1"){
+			continue;
+		}
+
+		load(&*block->body());
+	}
+}
+
+TypeProvider::TypeProvider(blender_blend_t::dna1_body_t *dna, int pointerSize){
+	this->pointerSize = pointerSize;
+
+	load(dna);
+}
+
+void TypeProvider::load(blender_blend_t::dna1_body_t *dna){
+	this->dna = dna;
+
+	for(int i = 0; i < dna->num_structs(); i++){
+		auto type = &*dna->structs()->at(i);
+		
+		typesByName[type->type()] = nullptr;
+		typesBySdnaIndex[i] = type->type();
+		sdnaIndexesByType[type->type()] = i;
+	}
+
+	for(int i = 0; i < dna->num_types(); i++){
+		auto name = dna->types()->at(i);
+		auto typeLength = dna->lengths()->at(i);
+
+		typeLengths[name] = typeLength;
+	}
+}
+
+void TypeProvider::finalize(){
+	if(finalized){
+		return;
+	}
+
+	typesBySdnaIndexFinal.resize(typesBySdnaIndex.size());
+
+	for(auto &type : typesBySdnaIndex){
+		typesBySdnaIndexFinal[type.first] = getType(type.second);
+	}
+
+	finalized = true;
+}
+
+int TypeProvider::getTypeLength(const std::string &name){
+	auto found = typeLengths.find(name);
+
+	if(found == typeLengths.end()){
+		throw std::runtime_error(std::string("Could not find type ") + name);
+	}
+
+	return found->second;
+}
+
+BlendType* TypeProvider::getType(int sdnaIndex){
+	if(finalized && sdnaIndex >= 0 && sdnaIndex < (int)typesBySdnaIndexFinal.size()){
+		return typesBySdnaIndexFinal[sdnaIndex];
+	}
+
+	if(!typesBySdnaIndex.count(sdnaIndex)){
+		char data[100];
+		sprintf(data, "Could not find type with SDNA index %i", sdnaIndex);
+		throw std::runtime_error(std::string(data));
+	}
+
+	auto name = typesBySdnaIndex.at(sdnaIndex);
+
+	return getType(name);
+}
+
+BlendType* TypeProvider::getType(const std::string &name){
+	auto found = typesByName.find(name);
+
+	if(found == typesByName.end()){
+		throw std::runtime_error(std::string("Could not find type ") + name);
+	}
+
+	if(found->second != nullptr){
+		return found->second;
+	}
+	if(finalized){
+		throw std::logic_error(std::string("Type ") + name + " was not compiled by finalize()");
+	}
+
+	int index = sdnaIndexesByType.at(name);
+
+	auto sdna_struct = &*dna->structs()->at(index);
+
+	std::vector<BlendField*> fields;
+	int offset = 0;
+	for(auto &field : *sdna_struct->fields()){
+		auto fieldName = field->name();
+		auto fieldType = field->type();
+		int size;
+		int arraySize = 1;
+		std::vector<int> dimensions;
+
+		if(fieldName[0] == '*' || fieldName[0] == '('){
+			size = pointerSize; // pointers and function pointers, (*func)()
+		} else {
+			size = getTypeLength(fieldType);
+		}
+
+		int bracketPosition = fieldName.find('[');
+
+		if(bracketPosition != -1){
+			size_t position = bracketPosition;
+
+			while(position < fieldName.length()){
+				if(fieldName[position] != '['){
+					throw std::runtime_error(std::string("Array syntax was not name[length][length]... in ") + fieldName);
+				}
+
+				auto bracketEnd = fieldName.find(']', position);
+
+				if(bracketEnd == std::string::npos){
+					throw std::runtime_error(std::string("Array syntax was not name[length] - no end bracket"));
+				}
+
+				dimensions.push_back(std::stoi(fieldName.substr(position + 1, bracketEnd - position - 1)));
+				arraySize *= dimensions.back();
+				position = bracketEnd + 1;
+			}
+
+			fieldName = fieldName.substr(0, bracketPosition);
+		}
+
+		size *= arraySize;
+
+		fields.push_back(new BlendField(fieldName, fieldType, size, offset, arraySize, dimensions));
+
+		offset += size;
+	}
+
+	if(offset != getTypeLength(name)){
+		char data[200];
+		sprintf(data, "Computed size %i of struct %s does not match its DNA length %i", offset, name.c_str(), getTypeLength(name));
+		throw std::runtime_error(std::string(data));
+	}
+
+	auto type = new BlendType(name, offset, fields);
+	types.push_back(std::unique_ptr<BlendType>(type));
+
+	compileLayout(type);
+
+	typesByName[type->name] = type;
+
+	return type;
+}
+
+void TypeProvider::compileLayout(BlendType *type){
+	for(auto field : type->getFields()){
+		auto path = new BlendPath();
+		path->type = field->type;
+		path->offset = field->offset;
+		path->elementSize = field->size / field->arraySize;
+		path->length = field->size;
+		path->dimensions = field->dimensions;
+		path->strides.resize(field->dimensions.size());
+
+		int stride = path->elementSize;
+		for(int i = field->dimensions.size() - 1; i >= 0; i--){
+			path->strides[i] = stride;
+			stride *= field->dimensions[i];
+		}
+
+		type->addPath(field->name, path);
+
+		bool isStruct = field->name[0] != '*' && field->name[0] != '(' && sdnaIndexesByType.count(field->type);
+
+		if(!isStruct){
+			continue;
+		}
+
+		auto fieldType = getType(field->type);
+
+		for(auto &nestedName : fieldType->getPathNames()){
+			auto nested = fieldType->locate(nestedName).path;
+			auto nestedPath = new BlendPath(*nested);
+
+			nestedPath->offset += field->offset;
+			nestedPath->dimensions.insert(nestedPath->dimensions.begin(), path->dimensions.begin(), path->dimensions.end());
+			nestedPath->strides.insert(nestedPath->strides.begin(), path->strides.begin(), path->strides.end());
+
+			type->addPath(field->name + "." + nestedName, nestedPath);
+		}
+	}
+}
+
+BlockCache::Scope::Scope(BlockCache *cache){
+	this->cache = cache;
+
+	if(cache != nullptr){
+		cache->beginScope();
+	}
+}
+
+BlockCache::Scope::~Scope(){
+	if(cache != nullptr){
+		cache->endScope();
+	}
+}
+
+void BlockCache::evict(Entry *keep){
+	auto position = recent.end();
+
+	while(residentSize > memoryBudget && position != recent.begin()){
+		auto entry = *--position;
+
+		if(entry->pinned || entry == keep){
+			continue;
+		}
+
+		residentSize -= entry->size;
+		std::string().swap(entry->body);
+		entry->resident = false;
+		position = recent.erase(position);
+		evictionCount++;
+	}
+}
+
+void BlockCache::beginScope(){
+	std::lock_guard<std::mutex> lock(mutex);
+	scopeDepth++;
+}
+
+void BlockCache::endScope(){
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(--scopeDepth > 0){
+		return;
+	}
+
+	for(auto entry : pinnedEntries){
+		entry->pinned = false;
+	}
+	pinnedEntries.clear();
+
+	evict(nullptr);
+}
+
+BlockCache::BlockCache(std::string path, size_t memoryBudget) : stream(path, std::ifstream::binary){
+	this->path = path;
+	this->memoryBudget = memoryBudget;
+	this->residentSize = 0;
+	this->peakSize = 0;
+	this->loadCount = 0;
+	this->evictionCount = 0;
+	this->scopeDepth = 0;
+
+	if(!stream){
+		throw std::runtime_error(std::string("Could not read file ") + path);
+	}
+}
+
+BlockCache::Entry* BlockCache::add(size_t fileOffset, size_t size){
+	auto entry = new Entry();
+	entry->fileOffset = fileOffset;
+	entry->size = size;
+	entry->resident = false;
+	entry->pinned = false;
+
+	entries.push_back(std::unique_ptr<Entry>(entry));
+
+	return entry;
+}
+
+const char* BlockCache::get(Entry *entry){
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(entry->resident){
+		recent.splice(recent.begin(), recent, entry->position);
+	} else {
+		MemoryScope scope(MEMORY_BLOCK_BODIES);
+		entry->body.resize(entry->size);
+		stream.seekg(entry->fileOffset);
+		stream.read(&entry->body[0], entry->size);
+
+		if(!stream){
+			throw std::runtime_error(std::string("Could not read block body from ") + path);
+		}
+
+		entry->resident = true;
+		recent.push_front(entry);
+		entry->position = recent.begin();
+		residentSize += entry->size;
+		loadCount++;
+	}
+
+	if(scopeDepth > 0 && !entry->pinned){
+		entry->pinned = true;
+		pinnedEntries.push_back(entry);
+	}
+
+	evict(entry);
+	peakSize = std::max(peakSize, residentSize);
+
+	return entry->body.data();
+}
+
+size_t BlockCache::getMemoryBudget(){
+	return memoryBudget;
+}
+
+size_t BlockCache::getPeakSize(){
+	std::lock_guard<std::mutex> lock(mutex);
+	return peakSize;
+}
+
+void BlockCache::printStatistics(){
+	printf("Block cache: %u loads, %u evictions, peak %0.2f MB of %0.2f MB budget\n", loadCount, evictionCount, peakSize / (1024.0 * 1024.0), memoryBudget / (1024.0 * 1024.0));
+}
+
+DataSource::DataSource(std::string raw_body){
+	this->raw_body = std::move(raw_body);
+	this->cache = nullptr;
+	this->entry = nullptr;
+}
+
+DataSource::DataSource(BlockCache *cache, BlockCache::Entry *entry){
+	this->cache = cache;
+	this->entry = entry;
+}
+
+const char* DataSource::getData(){
+	if(cache != nullptr){
+		return cache->get(entry);
+	}
+
+	return raw_body.data();
+}
+
+size_t DataSource::getSize(){
+	return cache != nullptr ? entry->size : raw_body.size();
+}
+
+long long DataSource::getFileOffset(){
+	return cache != nullptr ? (long long)entry->fileOffset : -1;
+}
+
+const char* DataPart::getAddress(int fieldOffset, size_t length) const {
+	if(offset + fieldOffset + length > size){
+		char message[100];
+		sprintf(message, "Read of %i bytes at offset %i is outside of the block", (int)length, (int)(offset + fieldOffset));
+		throw std::runtime_error(std::string(message));
+	}
+
+	return data + offset + fieldOffset;
+}
+
+DataPart::DataPart(){
+	this->typeProvider = nullptr;
+	this->data = nullptr;
+	this->size = 0;
+	this->offset = 0;
+	this->type = nullptr;
+}
+
+DataPart::DataPart(TypeProvider *typeProvider, DataSource *dataSource, size_t offset, BlendType *type){
+	this->typeProvider = typeProvider;
+	this->data = dataSource != nullptr ? dataSource->getData() : nullptr;
+	this->size = dataSource != nullptr ? dataSource->getSize() : 0;
+	this->offset = offset;
+	this->type = type;
+}
+
+DataPart DataPart::rebind(DataSource *dataSource) const {
+	auto result = *this;
+	result.data = dataSource->getData();
+	result.size = dataSource->getSize();
+	return result;
+}
+
+const char* DataPart::getData() const {
+	return data + offset;
+}
+
+DataPart DataPart::getPart(const std::string &name) const {
+	auto location = type->locate(name);
+	auto result = *this;
+
+	result.offset = offset + location.offset;
+	result.type = typeProvider->getType(location.path->type);
+
+	return result;
+}
+
+int32_t DataPart::getInt(const std::string &name, unsigned int arrayIndex) const {
+	return read<int32_t>(name, arrayIndex, "int");
+}
+
+int32_t DataPart::getShort(const std::string &name, unsigned int arrayIndex) const {
+	return read<int16_t>(name, arrayIndex, "short");
+}
+
+int32_t DataPart::getChar(const std::string &name, unsigned int arrayIndex) const {
+	return read<int8_t>(name, arrayIndex, "char");
+}
+
+float DataPart::getFloat(const std::string &name, unsigned int arrayIndex) const {
+	return read<float>(name, arrayIndex, "float");
+}
+
+std::string DataPart::getString(const std::string &name) const {
+	auto location = type->locate(name);
+
+	return std::string(getAddress(location.offset, location.length), location.length);
+}
+
+unsigned long long DataPart::getPointer(const std::string &name) const {
+	auto fieldOffset = type->getOffset(name);
+
+	return readPointer(getAddress(fieldOffset, typeProvider->pointerSize), typeProvider->pointerSize);
+}
+
+DataBlock::DataBlock(DataSource *dataSource, DataPart part, unsigned int index, std::string code, unsigned long long memaddr, unsigned int count){
+	this->dataSource = std::unique_ptr<DataSource>(dataSource);
+	this->part = part;
+	this->index = index;
+	this->code = code;
+	this->memaddr = memaddr;
+	this->count = count;
+}
+
+DataPart DataBlock::getPart(){
+	return part.rebind(&*dataSource);
+}
+
+DataArray::DataArray(){
+	this->block = nullptr;
+	this->type = nullptr;
+	this->data = nullptr;
+	this->count = 0;
+}
+
+DataArray::DataArray(DataBlock *block, BlendType *type, size_t offset){
+	this->block = block;
+	this->type = type;
+	this->data = block->dataSource->getData() + offset;
+	this->count = type->size ? (block->dataSource->getSize() - offset) / type->size : 0;
+}
+
+bool BlockIndex::FileStamp::operator==(const FileStamp &other) const {
+	return size == other.size && modified == other.modified && hash == other.hash;
+}
+
+bool BlockIndex::getStamp(std::string path, FileStamp &stamp){
+	struct stat status;
+	if(stat(path.c_str(), &status) != 0){
+		return false;
+	}
+
+	stamp.size = status.st_size;
+#ifdef __APPLE__
+	stamp.modified = status.st_mtimespec.tv_sec * 1000000000LL + status.st_mtimespec.tv_nsec;
+#else
+	stamp.modified = status.st_mtim.tv_sec * 1000000000LL + status.st_mtim.tv_nsec;
+#endif
+	stamp.hash = 14695981039346656037ULL;
+
+	std::ifstream is(path, std::ifstream::binary);
+	std::vector<char> buffer(std::min(stamp.size, uint64_t(hashedBytes)));
+
+	for(auto start : { (uint64_t)0, stamp.size - buffer.size() }){
+		if(!is.seekg(start) || !is.read(buffer.data(), buffer.size())){
+			return false;
+		}
+		for(auto c : buffer){
+			stamp.hash = (stamp.hash ^ (uint8_t)c) * 1099511628211ULL;
+		}
+	}
+
+	return true;
+}
+
+std::string BlockIndex::take(const std::string &contents, size_t &offset, size_t length){
+	if(offset + length > contents.size()){
+		throw std::runtime_error("Block index is truncated");
+	}
+
+	offset += length;
+	return contents.substr(offset - length, length);
+}
+
+std::string BlockIndex::getPath(std::string blendPath){
+	return blendPath + "idx";
+}
+
+bool BlockIndex::read(std::string blendPath){
+	std::string contents;
+	FileStamp stamp;
+
+	if(!readFile(getPath(blendPath), contents) || !getStamp(blendPath, stamp)){
+		return false;
+	}
+
+	try {
+		size_t offset = 0;
+		FileStamp indexStamp;
+
+		if(contents.compare(0, 8, "BLENDIDX") != 0){
+			return false;
+		}
+		offset += 8;
+
+		if(take<uint32_t>(contents, offset) != formatVersion){
+			return false;
+		}
+
+		indexStamp.size = take<uint64_t>(contents, offset);
+		indexStamp.modified = take<int64_t>(contents, offset);
+		indexStamp.hash = take<uint64_t>(contents, offset);
+		if(!(indexStamp == stamp)){
+			return false;
+		}
+
+		pointerSize = take<uint32_t>(contents, offset);
+		endian = take<char>(contents, offset);
+		version = take(contents, offset, 3);
+
+		auto count = take<uint32_t>(contents, offset);
+		if(count > (contents.size() - offset) / 36){
+			return false;
+		}
+		headers.resize(count);
+
+		for(auto &header : headers){
+			header.code = take(contents, offset, 4);
+			header.memaddr = take<uint64_t>(contents, offset);
+			header.sdnaIndex = take<int32_t>(contents, offset);
+			header.count = take<uint32_t>(contents, offset);
+			header.offset = take<uint64_t>(contents, offset);
+			header.size = take<uint64_t>(contents, offset);
+		}
+	} catch(const std::runtime_error &e) {
+		return false;
+	}
+
+	return true;
+}
+
+bool BlockIndex::write(std::string blendPath){
+	std::string contents = "BLENDIDX";
+	FileStamp stamp;
+
+	if(!getStamp(blendPath, stamp)){
+		return false;
+	}
+
+	put<uint32_t>(contents, formatVersion);
+	put<uint64_t>(contents, stamp.size);
+	put<int64_t>(contents, stamp.modified);
+	put<uint64_t>(contents, stamp.hash);
+	put<uint32_t>(contents, pointerSize);
+	put<char>(contents, endian);
+	contents.append(version, 0, 3);
+	put<uint32_t>(contents, headers.size());
+
+	for(auto &header : headers){
+		contents.append(header.code, 0, 4);
+		put<uint64_t>(contents, header.memaddr);
+		put<int32_t>(contents, header.sdnaIndex);
+		put<uint32_t>(contents, header.count);
+		put<uint64_t>(contents, header.offset);
+		put<uint64_t>(contents, header.size);
+	}
+
+	return writeFile(getPath(blendPath), contents);
+}
+
+void BlockScanner::parseDna(std::string path){
+	if(dnaBody.empty()){
+		throw std::runtime_error(std::string("No DNA1 block in ") + path);
+	}
+
+	dnaStream = std::unique_ptr<kaitai::kstream>(new kaitai::kstream(dnaBody));
+	dna = std::unique_ptr<blender_blend_t::dna1_body_t>(new blender_blend_t::dna1_body_t(&*dnaStream));
+}
+
+BlockScanner::BlockScanner(std::string path, BlockIndex &index){
+	pointerSize = index.pointerSize;
+	endian = index.endian;
+	version = index.version;
+	headers = index.headers;
+
+	for(auto &header : headers){
+		if(header.code != std::string("DNA1", 4)){
+			continue;
+		}
+
+		std::ifstream is(path, std::ifstream::binary);
+		dnaBody.resize(header.size);
+		if(!is.seekg(header.offset) || !is.read(&dnaBody[0], header.size)){
+			throw std::runtime_error(std::string("Could not read DNA1 of ") + path);
+		}
+		break;
+	}
+
+	parseDna(path);
+}
+
+BlockScanner::BlockScanner(std::string path){
+	std::ifstream is(path, std::ifstream::binary);
+	char header[12];
+
+	if(!is.read(header, sizeof(header)) || memcmp(header, "BLENDER", 7) != 0){
+		throw std::runtime_error(std::string("Not a Blender file: ") + path);
+	}
+	if(header[8] != 'v'){
+		throw std::runtime_error(std::string("Only little endian files are supported: ") + path);
+	}
+
+	pointerSize = header[7] == '-' ? 8 : 4;
+	endian = header[8];
+	version = std::string(header + 9, 3);
+
+	size_t offset = sizeof(header);
+	size_t headerSize = 16 + pointerSize;
+	char blockHeader[24];
+
+	while(is.read(blockHeader, headerSize)){
+		BlockHeader block;
+		int size;
+
+		memcpy(&size, blockHeader + 4, sizeof(int));
+		memcpy(&block.sdnaIndex, blockHeader + 8 + pointerSize, sizeof(int));
+		memcpy(&block.count, blockHeader + 12 + pointerSize, sizeof(int));
+		block.code = std::string(blockHeader, 4);
+		block.memaddr = readPointer(blockHeader + 8, pointerSize);
+		block.offset = offset + headerSize;
+		block.size = size;
+
+		headers.push_back(block);
+
+		if(block.code == std::string("DNA1", 4)){
+			dnaBody.resize(block.size);
+			is.read(&dnaBody[0], block.size);
+		} else {
+			is.seekg(block.size, std::ios::cur);
+		}
+
+		offset = block.offset + block.size;
+
+		if(block.code == std::string("ENDB", 4)){
+			break;
+		}
+	}
+
+	parseDna(path);
+}
+
+BlockIndex BlockScanner::getIndex(){
+	BlockIndex index;
+
+	index.pointerSize = pointerSize;
+	index.endian = endian;
+	index.version = version;
+	index.headers = headers;
+
+	return index;
+}
+
+BlockProvider::BlockProvider(TypeProvider *typeProvider, blender_blend_t &data){
+	this->typeProvider = typeProvider;
+	pointerSize = data.hdr()->psize();
+
+	for(auto &block : *data.blocks()){
+		auto dataSource = new DataSource(block->_raw_body());
+		auto part = DataPart(typeProvider, dataSource, 0, typeProvider->getType(block->sdna_index()));
+
+		addBlock(dataSource, part, std::string(block->code()), readPointer(block->mem_addr().c_str(), pointerSize), block->count());
+	}
+
+	std::sort(blocksByAddress.begin(), blocksByAddress.end(), blockAddressComparer);
+}
+
+BlockProvider::BlockProvider(TypeProvider *typeProvider, BlockScanner &scanner, BlockCache *cache){
+	this->typeProvider = typeProvider;
+	pointerSize = scanner.pointerSize;
+
+	for(auto &header : scanner.headers){
+		auto dataSource = new DataSource(cache, cache->add(header.offset, header.size));
+		auto part = DataPart(typeProvider, nullptr, 0, typeProvider->getType(header.sdnaIndex));
+
+		addBlock(dataSource, part, header.code, header.memaddr, header.count);
+	}
+
+	std::sort(blocksByAddress.begin(), blocksByAddress.end(), blockAddressComparer);
+}
+
+void BlockProvider::addBlock(DataSource *dataSource, DataPart part, std::string code, unsigned long long position, unsigned int count){
+	blocks.push_back(std::unique_ptr<DataBlock>(new DataBlock(dataSource, part, blocks.size(), code, position, count)));
+
+	if(position != 0){ // ENDB block does that, empty markers to signify EOF.
+		MemoryScope scope(MEMORY_POINTERS);
+		blocksByAddress.push_back(&*blocks.back());
+	}
+}
+
+std::vector<DataBlock*> BlockProvider::getBlocks(){
+	std::vector<DataBlock*> result;
+	for(auto &block : blocks){
+		result.push_back(&*block);
+	}
+	return result;
+}
+
+DataBlock* BlockProvider::getBlock(unsigned long long pointer){
+	auto block = findBlock(pointer);
+
+	if(block == nullptr){
+		char data[100];
+		sprintf(data, "Could not resolve pointer 0x%08llx to a block", pointer);
+		throw std::runtime_error(std::string(data));
+	}
+
+	return block;
+}
+
+DataBlock* BlockProvider::findBlock(unsigned long long pointer){
+	DataBlock key(nullptr, DataPart(), 0, "", pointer, 0);
+	auto position = std::upper_bound(blocksByAddress.begin(), blocksByAddress.end(), &key, blockAddressComparer);
+
+	if(position != blocksByAddress.begin()){
+		auto block = *(position - 1);
+
+		if(pointer == block->memaddr){
+			return block; // blocks can overlap (TreeStore), a pointer to a block start is never ambiguous
+		}
+
+		if(pointer < block->memaddr + block->dataSource->getSize()){
+			if(position - 1 != blocksByAddress.begin()){
+				auto previous = *(position - 2);
+
+				if(pointer == previous->memaddr || pointer < previous->memaddr + previous->dataSource->getSize()){
+					char data[100];
+					sprintf(data, "Ambigious pointer reference - 0x%08llx resolves to multiple blocks", pointer);
+					throw std::runtime_error(std::string(data));
+				}
+			}
+
+			return block;
+		}
+	}
+
+	return nullptr;
+}
+
+DataBlock* BlockProvider::getBlock(std::string code){
+	auto blocks = getBlocks(code, 1);
+
+	if(blocks.empty()){
+		throw std::runtime_error(std::string("Could not find block ") + code);
+	}
+
+	return blocks.at(0);
+}
+
+std::vector<DataBlock*> BlockProvider::getBlocks(std::string code, size_t maxCount){
+	if(code.length() == 2){
+		char codeChars[4] = {
+			code[0],
+			code[1],
+			'\0',
+			'\0',
+		};
+		code = std::string(codeChars, 4);
+	}
+	if(code.length() == 3){
+		char codeChars[4] = {
+			code[0],
+			code[1],
+			code[2],
+			'\0',
+		};
+		code = std::string(codeChars, 4);
+	}
+
+	std::vector<DataBlock*> result;
+
+	for(auto &block : blocks){
+		if(block->code != code){
+			continue;
+		}
+
+		result.push_back(&*block);
+
+		if(result.size() >= maxCount){
+			break;
+		}
+	}
+
+	return result;
+}
+
+DataPart ListBaseRange::iterator::resolve(unsigned long long address){
+	if(address == 0){
+		return DataPart();
+	}
+
+	auto block = blockProvider->getBlock(address);
+	auto part = DataPart(typeProvider, &*block->dataSource, address - block->memaddr, block->part.type);
+
+#if defined(__GNUC__)
+	__builtin_prefetch(part.getData());
+#endif
+
+	return part;
+}
+
+unsigned long long ListBaseRange::iterator::getNextAddress(const DataPart &part){
+	return readPointer(part.getData(), typeProvider->pointerSize);
+}
+
+ListBaseRange::iterator::iterator(TypeProvider *typeProvider, BlockProvider *blockProvider, unsigned long long address){
+	this->typeProvider = typeProvider;
+	this->blockProvider = blockProvider;
+	this->address = address;
+	this->tortoise = address;
+	this->power = 1;
+	this->length = 0;
+
+	current = resolve(address);
+	nextAddress = address == 0 ? 0 : getNextAddress(current);
+	next = resolve(nextAddress);
+}
+
+DataPart ListBaseRange::iterator::operator*() const {
+	return current;
+}
+
+ListBaseRange::iterator& ListBaseRange::iterator::operator++(){
+	address = nextAddress;
+	current = next;
+
+	if(address == tortoise){
+		char data[100];
+		sprintf(data, "ListBase contains a cycle at 0x%08llx", address);
+		throw std::runtime_error(std::string(data));
+	}
+	if(++length == power){
+		tortoise = address;
+		power *= 2;
+		length = 0;
+	}
+
+	nextAddress = address == 0 ? 0 : getNextAddress(current);
+	next = resolve(nextAddress);
+
+	return *this;
+}
+
+bool ListBaseRange::iterator::operator!=(const iterator &other) const {
+	return address != other.address;
+}
+
+unsigned long long ListBaseRange::iterator::getAddress() const {
+	return address;
+}
+
+ListBaseRange::ListBaseRange(TypeProvider *typeProvider, BlockProvider *blockProvider, unsigned long long first){
+	this->typeProvider = typeProvider;
+	this->blockProvider = blockProvider;
+	this->first = first;
+}
+
+ListBaseRange::iterator ListBaseRange::begin(){
+	return iterator(typeProvider, blockProvider, first);
+}
+
+ListBaseRange::iterator ListBaseRange::end(){
+	return iterator(typeProvider, blockProvider, 0);
+}
+
+PointedDataProvider::PointedDataProvider(TypeProvider *typeProvider, BlockProvider *blockProvider){
+	this->typeProvider = typeProvider;
+	this->blockProvider = blockProvider;
+}
+
+DataPart PointedDataProvider::getPointedData(const DataPart &dataPart, const std::string &name, unsigned int arrayIndex){
+	auto pointer = dataPart.getPointer(name);
+	auto block = blockProvider->getBlock(pointer);
+	auto fieldType = typeProvider->getType(dataPart.type->locate(name).path->type);
+
+	return DataPart(typeProvider, &*block->dataSource, pointer - block->memaddr + fieldType->size * arrayIndex, fieldType);
+}
+
+DataArray PointedDataProvider::getPointedArray(const DataPart &dataPart, const std::string &name){
+	auto pointer = dataPart.getPointer(name);
+
+	if(pointer == 0){
+		return DataArray();
+	}
+
+	auto block = blockProvider->getBlock(pointer);
+	auto fieldType = typeProvider->getType(dataPart.type->locate(name).path->type);
+
+	return DataArray(block, fieldType, pointer - block->memaddr);
+}
+
+const char* PointedDataProvider::getPointedBytes(const DataPart &dataPart, const std::string &name, size_t &size){
+	auto pointer = dataPart.getPointer(name);
+	size = 0;
+
+	if(pointer == 0){
+		return nullptr;
+	}
+
+	auto block = blockProvider->getBlock(pointer);
+	auto offset = pointer - block->memaddr;
+	size = block->dataSource->getSize() - offset;
+
+	return block->dataSource->getData() + offset;
+}
+
+ListBaseRange PointedDataProvider::getList(const DataPart &dataPart, const std::string &name){
+	return ListBaseRange(typeProvider, blockProvider, dataPart.getPointer(name + ".*first"));
+}
+
+void BlendFile::load(const std::string &contents){
+	MemoryTracker::addInput(contents.size());
+
+	{
+		MemoryScope scope(MEMORY_PARSE_TREE);
+		stream = std::unique_ptr<kaitai::kstream>(new kaitai::kstream(contents));
+		data = std::unique_ptr<blender_blend_t>(new blender_blend_t(&*stream));
+	}
+	{
+		MemoryScope scope(MEMORY_SCHEMA);
+		typeProvider = std::unique_ptr<TypeProvider>(new TypeProvider(*data));
+		typeProvider->finalize();
+	}
+
+	// The generated parser computes some fields on first access; read them all now,
+	// so the parse tree is never modified while the file is shared between threads
+	// (sdna_structs() expects DNA1 to be the block before ENDB, as Blender writes it)
+	auto blocks = data->blocks();
+	if(blocks->size() >= 2 && blocks->at(blocks->size() - 2)->code() == "DNA1"){
+		MemoryScope scope(MEMORY_PARSE_TREE);
+		for(auto &block : *blocks){
+			block->sdna_struct();
+		}
+	}
+
+	MemoryScope scope(MEMORY_BLOCK_BODIES);
+	blockProvider = std::unique_ptr<BlockProvider>(new BlockProvider(&*typeProvider, *data));
+	pointedDataProvider = std::unique_ptr<PointedDataProvider>(new PointedDataProvider(&*typeProvider, &*blockProvider));
+}
+
+BlendFile::BlendFile(std::string path){
+	this->path = path;
+
+	std::string contents;
+	if(!readFile(path, contents)){
+		throw std::runtime_error(std::string("Could not read file ") + path);
+	}
+
+	load(contents);
+}
+
+BlendFile::BlendFile(std::string path, const std::string &contents){
+	this->path = path;
+
+	load(contents);
+}
+
+BlendFile::BlendFile(std::string path, size_t memoryBudget){
+	this->path = path;
+
+	MemoryScope scope(MEMORY_SCHEMA);
+	BlockIndex index;
+	if(index.read(path)){
+		scanner = std::unique_ptr<BlockScanner>(new BlockScanner(path, index));
+	} else {
+		scanner = std::unique_ptr<BlockScanner>(new BlockScanner(path));
+	}
+	typeProvider = std::unique_ptr<TypeProvider>(new TypeProvider(&*scanner->dna, scanner->pointerSize));
+	typeProvider->finalize();
+
+	auto &last = scanner->headers.back();
+	MemoryTracker::addInput(last.offset + last.size);
+
+	MemoryScope bodyScope(MEMORY_BLOCK_BODIES);
+	cache = std::unique_ptr<BlockCache>(new BlockCache(path, memoryBudget));
+	blockProvider = std::unique_ptr<BlockProvider>(new BlockProvider(&*typeProvider, *scanner, &*cache));
+	pointedDataProvider = std::unique_ptr<PointedDataProvider>(new PointedDataProvider(&*typeProvider, &*blockProvider));
+}
+
+std::string BlendFileCache::getKey(std::string path){
+	char resolved[PATH_MAX];
+
+	if(realpath(path.c_str(), resolved) == nullptr){
+		return path;
+	}
+
+	return resolved;
+}
+
+BlendFileCache& BlendFileCache::getShared(){
+	static BlendFileCache cache;
+	return cache;
+}
+
+std::shared_ptr<BlendFile> BlendFileCache::open(std::string path, size_t memoryBudget){
+	auto key = getKey(path);
+	std::promise<std::shared_ptr<BlendFile>> promise;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		if(files.count(key)){
+			auto file = files.at(key);
+			lock.unlock();
+			return file.get();
+		}
+
+		files[key] = promise.get_future().share();
+	}
+
+	try {
+		auto file = memoryBudget ? std::make_shared<BlendFile>(path, memoryBudget) : std::make_shared<BlendFile>(path);
+		promise.set_value(file);
+		return file;
+	} catch(...) {
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+}
+
+void BlendFileCache::collect(){
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for(auto i = files.begin(); i != files.end();){
+		if(i->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+			i++;
+			continue;
+		}
+
+		try {
+			if(i->second.get().use_count() > 1){
+				i++;
+				continue;
+			}
+		} catch(const std::exception &e) {
+			// failed loads are dropped so they are tried again
+		}
+
+		i = files.erase(i);
+	}
+}
+
+LinkedId::LinkedId(std::shared_ptr<BlendFile> library, BlendFile *file, DataBlock *block){
+	this->library = library;
+	this->file = file;
+	this->block = block;
+}
+
+LibraryLinker::LibraryLinker(BlendFile *file, BlendFileCache *cache){
+	this->file = file;
+	this->cache = cache;
+}
+
+std::string LibraryLinker::getLibraryPath(const DataPart &library){
+	auto path = std::string(library.getString("name").c_str());
+
+	std::replace(path.begin(), path.end(), '\\', '/');
+
+	if(path.compare(0, 2, "//") == 0){
+		auto slash = file->path.find_last_of('/');
+		auto directory = slash == std::string::npos ? std::string("") : file->path.substr(0, slash + 1);
+
+		path = directory + path.substr(2);
+	}
+
+	return path;
+}
+
+std::vector<DataBlock*> LibraryLinker::getLinkedIds(std::string code){
+	std::vector<DataBlock*> result;
+
+	for(auto block : file->blockProvider->getBlocks("ID")){
+		auto part = block->getPart();
+
+		if(part.getString("name").compare(0, code.size(), code) == 0 && part.getPointer("*lib") != 0){
+			result.push_back(block);
+		}
+	}
+
+	return result;
+}
+
+LinkedId LibraryLinker::resolve(DataBlock *placeholder){
+	BlockCache::Scope scope(file->cache.get());
+	auto part = placeholder->getPart();
+	auto name = std::string(part.getString("name").c_str());
+	auto library = file->blockProvider->getBlock(part.getPointer("*lib"));
+	auto memoryBudget = file->cache ? file->cache->getMemoryBudget() : 0;
+	auto libraryFile = cache->open(getLibraryPath(library->getPart()), memoryBudget);
+
+	for(auto block : libraryFile->blockProvider->getBlocks(name.substr(0, 2))){
+		if(block->getPart().getString("id.name").c_str() == name){
+			return LinkedId(libraryFile, &*libraryFile, block);
+		}
+	}
+
+	throw std::runtime_error(std::string("Could not find ") + name + " in library " + libraryFile->path);
+}
+
+UVConverter::UVConverter(float pageWidth, float pageHeight){
+	this->pageWidth = pageWidth;
+	this->pageHeight = pageHeight;
+}
+
+std::vector<float> UVConverter::convert(const DataArray &mloopuv, int loopCount){
+	std::vector<float> result(loopCount * 2);
+
+	if(mloopuv.data == nullptr){
+		return result;
+	}
+
+	if(mloopuv.count < loopCount){
+		char data[100];
+		sprintf(data, "MLoopUV array holds %i elements, expected %i", mloopuv.count, loopCount);
+		throw std::runtime_error(std::string(data));
+	}
+
+	convert(mloopuv.data + mloopuv.type->getOffset("uv"), mloopuv.type->size, loopCount, result);
+	return result;
+}
+
+void UVConverter::convert(const char *source, int stride, int loopCount, std::vector<float> &result){
+	result.resize(loopCount * 2);
+	auto target = result.data();
+
+	for(int i = 0; i < loopCount; i++){
+		memcpy(target + i * 2, source + i * stride, sizeof(float) * 2);
+	}
+
+	// u' = u * width, v' = height - v * height, on interleaved (u, v) pairs
+	float scale[4] = { pageWidth, -pageHeight, pageWidth, -pageHeight };
+	float bias[4] = { 0, pageHeight, 0, pageHeight };
+	int count = loopCount * 2;
+	int i = 0;
+
+#ifdef __SSE2__
+	auto scaleVector = _mm_loadu_ps(scale);
+	auto biasVector = _mm_loadu_ps(bias);
+
+	for(; i + 4 <= count; i += 4){
+		auto uv = _mm_loadu_ps(target + i);
+		_mm_storeu_ps(target + i, _mm_add_ps(_mm_mul_ps(uv, scaleVector), biasVector));
+	}
+#endif
+
+	for(; i < count; i++){
+		target[i] = target[i] * scale[i % 2] + bias[i % 2];
+	}
+}
+
+int ExtractedMesh::getVertexCount(){
+	return positions.size() / 3;
+}
+
+int ExtractedMesh::getLoopCount(){
+	return loopVertices.size();
+}
+
+int ExtractedMesh::getPolyCount(){
+	return polyLoopStarts.size();
+}
+
+int ExtractedMesh::getTriangleCount(){
+	return triangles.size() / 3;
+}
+
+AttributeLayer::AttributeLayer(){
+	this->type = -1;
+	this->data = nullptr;
+	this->size = 0;
+}
+
+CustomDataReader::CustomDataReader(PointedDataProvider *pointedDataProvider){
+	this->pointedDataProvider = pointedDataProvider;
+}
+
+std::vector<AttributeLayer> CustomDataReader::getLayers(const DataPart &owner, const std::string &customData){
+	std::vector<AttributeLayer> result;
+
+	auto layers = pointedDataProvider->getPointedArray(owner, customData + ".*layers");
+	auto count = owner.getInt(customData + ".totlayer");
+
+	if(layers.data == nullptr){
+		return result;
+	}
+	if(layers.count < count){
+		char data[100];
+		sprintf(data, "CustomData holds %i layers, expected %i", layers.count, count);
+		throw std::runtime_error(std::string(data));
+	}
+
+	for(int i = 0; i < count; i++){
+		auto part = pointedDataProvider->getPointedData(owner, customData + ".*layers", i);
+
+		AttributeLayer layer;
+		layer.name = part.getString("name").c_str();
+		layer.type = part.getInt("type");
+		layer.data = pointedDataProvider->getPointedBytes(part, "*data", layer.size);
+		result.push_back(layer);
+	}
+
+	return result;
+}
+
+AttributeLayer CustomDataReader::findLayer(const DataPart &owner, const std::string &customData, const std::string &name, int type){
+	auto key = std::make_pair(owner.getData(), customData);
+	auto layers = layersByCustomData.find(key);
+
+	if(layers == layersByCustomData.end()){
+		layers = layersByCustomData.emplace(key, getLayers(owner, customData)).first;
+	}
+
+	for(auto &layer : layers->second){
+		if(layer.type != type || layer.data == nullptr){
+			continue;
+		}
+		if(name.empty() ? layer.name.compare(0, 1, ".") != 0 : layer.name == name){
+			return layer;
+		}
+	}
+
+	return AttributeLayer();
+}
+
+std::string MeshExtractor::findPath(const DataPart &part, std::vector<std::string> names){
+	for(auto &name : names){
+		if(part.type->hasPath(name)){
+			return name;
+		}
+	}
+
+	throw std::runtime_error(std::string("Could not find field ") + names[0] + " on type " + part.type->name);
+}
+
+bool MeshExtractor::hasPointer(const DataPart &part, const std::string &name){
+	return part.type->hasPath(name) && part.getPointer(name) != 0;
+}
+
+void MeshExtractor::readShading(const DataPart &mesh, CustomDataReader &customData, ExtractedMesh *result){
+	enum {
+		ME_SMOOTH = 1 << 0,
+		ME_AUTOSMOOTH = 1 << 5,
+		ME_SHARP = 1 << 9
+	};
+
+	auto loopCount = result->getLoopCount();
+	auto polyCount = result->getPolyCount();
+	auto edgeCount = mesh.getInt(findPath(mesh, { "totedge", "edges_num" }));
+	auto edgeData = findPath(mesh, { "edata", "edge_data" });
+	auto polyData = findPath(mesh, { "pdata", "face_data" });
+
+	if(hasPointer(mesh, "*mloop")){
+		gather(pointedDataProvider->getPointedArray(mesh, "*mloop"), "e", loopCount, 1, result->loopEdges);
+	} else {
+		auto layer = customData.findLayer(mesh, findPath(mesh, { "ldata", "corner_data" }), ".corner_edge", CD_PROP_INT32);
+
+		if(layer.data != nullptr){
+			gather(layer, loopCount, 1, result->loopEdges);
+		}
+	}
+
+	if(hasPointer(mesh, "*medge")){
+		std::vector<short> flags;
+		gather(pointedDataProvider->getPointedArray(mesh, "*medge"), "flag", edgeCount, 1, flags);
+
+		result->sharpEdges.resize(edgeCount);
+		for(int i = 0; i < edgeCount; i++){
+			result->sharpEdges[i] = (flags[i] & ME_SHARP) != 0;
+		}
+	} else {
+		auto layer = customData.findLayer(mesh, edgeData, "sharp_edge", CD_PROP_BOOL);
+
+		if(layer.data != nullptr){
+			gather(layer, edgeCount, 1, result->sharpEdges);
+		}
+	}
+
+	if(hasPointer(mesh, "*mpoly")){
+		std::vector<char> flags;
+		gather(pointedDataProvider->getPointedArray(mesh, "*mpoly"), "flag", polyCount, 1, flags);
+
+		result->smoothPolys.resize(polyCount);
+		for(int i = 0; i < polyCount; i++){
+			result->smoothPolys[i] = (flags[i] & ME_SMOOTH) != 0;
+		}
+	} else {
+		auto layer = customData.findLayer(mesh, polyData, "sharp_face", CD_PROP_BOOL);
+
+		if(layer.data != nullptr){
+			gather(layer, polyCount, 1, result->smoothPolys);
+			for(auto &smooth : result->smoothPolys){
+				smooth = !smooth;
+			}
+		}
+	}
+
+	if(mesh.type->hasPath("smoothresh")){
+		if(mesh.getShort("flag") & ME_AUTOSMOOTH){
+			result->autoSmoothAngle = mesh.getFloat("smoothresh");
+		} else {
+			result->sharpEdges.clear();
+		}
+	}
+}
+
+MeshExtractor::MeshExtractor(PointedDataProvider *pointedDataProvider){
+	this->pointedDataProvider = pointedDataProvider;
+}
+
+std::unique_ptr<ExtractedMesh> MeshExtractor::extract(const DataPart &mesh){
+	auto result = std::unique_ptr<ExtractedMesh>(new ExtractedMesh());
+	CustomDataReader customData(pointedDataProvider);
+
+	result->name = mesh.getString("id.name").c_str();
+
+	auto vertexCount = mesh.getInt(findPath(mesh, { "totvert", "verts_num" }));
+	auto loopCount = mesh.getInt(findPath(mesh, { "totloop", "corners_num" }));
+	auto polyCount = mesh.getInt(findPath(mesh, { "totpoly", "faces_num" }));
+	auto vertexData = findPath(mesh, { "vdata", "vert_data" });
+	auto loopData = findPath(mesh, { "ldata", "corner_data" });
+
+	if(hasPointer(mesh, "*mvert")){
+		gather(pointedDataProvider->getPointedArray(mesh, "*mvert"), "co", vertexCount, 3, result->positions);
+	} else {
+		gather(customData.findLayer(mesh, vertexData, "position", CD_PROP_FLOAT3), vertexCount, 3, result->positions);
+	}
+
+	if(hasPointer(mesh, "*mloop")){
+		gather(pointedDataProvider->getPointedArray(mesh, "*mloop"), "v", loopCount, 1, result->loopVertices);
+	} else {
+		gather(customData.findLayer(mesh, loopData, ".corner_vert", CD_PROP_INT32), loopCount, 1, result->loopVertices);
+	}
+
+	if(hasPointer(mesh, "*mpoly")){
+		auto mpoly = pointedDataProvider->getPointedArray(mesh, "*mpoly");
+		gather(mpoly, "loopstart", polyCount, 1, result->polyLoopStarts);
+		gather(mpoly, "totloop", polyCount, 1, result->polyLoopCounts);
+	} else if(polyCount > 0){
+		// Faces are a single offsets array with polyCount + 1 entries
+		AttributeLayer offsets;
+		offsets.name = "face offsets";
+		offsets.data = pointedDataProvider->getPointedBytes(mesh, findPath(mesh, { "*face_offset_indices", "*poly_offset_indices" }), offsets.size);
+
+		std::vector<int> starts;
+		gather(offsets, polyCount + 1, 1, starts);
+
+		result->polyLoopCounts.resize(polyCount);
+		for(int i = 0; i < polyCount; i++){
+			result->polyLoopCounts[i] = starts[i + 1] - starts[i];
+		}
+		starts.pop_back();
+		result->polyLoopStarts = std::move(starts);
+	}
+
+	readShading(mesh, customData, result.get());
+
+	if(hasPointer(mesh, "*mloopuv")){
+		result->uvs = UVConverter(1, 1).convert(pointedDataProvider->getPointedArray(mesh, "*mloopuv"), loopCount);
+	} else {
+		auto layer = customData.findLayer(mesh, loopData, "", CD_PROP_FLOAT2);
+
+		if(layer.data != nullptr && layer.size >= loopCount * sizeof(float) * 2){
+			UVConverter(1, 1).convert(layer.data, sizeof(float) * 2, loopCount, result->uvs);
+		} else {
+			result->uvs.assign(loopCount * 2, 0);
+		}
+	}
+
+	return result;
+}
+
+void PositionTransformer::reverseWindings(ExtractedMesh *mesh){
+	bool hasEdges = mesh->loopEdges.size() == mesh->loopVertices.size();
+	bool hasUvs = mesh->uvs.size() == mesh->loopVertices.size() * 2;
+
+	parallelFor(mesh->getPolyCount(), 1 << 12, [mesh, hasEdges, hasUvs](size_t begin, size_t end){
+		std::vector<int> vertices;
+		std::vector<int> edges;
+		std::vector<float> uvs;
+
+		for(size_t poly = begin; poly < end; poly++){
+			auto start = mesh->polyLoopStarts[poly];
+			auto count = mesh->polyLoopCounts[poly];
+
+			vertices.assign(&mesh->loopVertices[start], &mesh->loopVertices[start] + count);
+			if(hasUvs){
+				uvs.assign(&mesh->uvs[start * 2], &mesh->uvs[start * 2] + count * 2);
+			}
+			if(hasEdges){
+				edges.assign(&mesh->loopEdges[start], &mesh->loopEdges[start] + count);
+			}
+
+			// The first loop stays, the rest run backwards; the edge of a loop leads to
+			// the next loop, which is the previous edge of the old order
+			for(int i = 0; i < count; i++){
+				auto from = (count - i) % count;
+
+				mesh->loopVertices[start + i] = vertices[from];
+				if(hasUvs){
+					mesh->uvs[(start + i) * 2] = uvs[from * 2];
+					mesh->uvs[(start + i) * 2 + 1] = uvs[from * 2 + 1];
+				}
+				if(hasEdges){
+					mesh->loopEdges[start + i] = edges[(2 * count - i - 1) % count];
+				}
+			}
+		}
+	});
+}
+
+PositionTransformer::PositionTransformer(const float *objectMatrix, float scale, float step){
+	float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	auto source = objectMatrix ? objectMatrix : identity;
+
+	for(int column = 0; column < 4; column++){
+		matrix[column * 4] = scale * source[column * 4];
+		matrix[column * 4 + 1] = scale * source[column * 4 + 2];
+		matrix[column * 4 + 2] = -scale * source[column * 4 + 1];
+		matrix[column * 4 + 3] = 0;
+	}
+
+	this->step = step;
+}
+
+bool PositionTransformer::isMirrored(){
+	auto m = matrix;
+	float determinant = m[0] * (m[5] * m[10] - m[9] * m[6]) - m[4] * (m[1] * m[10] - m[9] * m[2]) + m[8] * (m[1] * m[6] - m[5] * m[2]);
+	return determinant < 0;
+}
+
+Bounds PositionTransformer::transform(ExtractedMesh *mesh){
+	auto vertexCount = mesh->getVertexCount();
+	auto positions = mesh->positions.data();
+	auto step = this->step;
+	auto matrix = this->matrix;
+	std::vector<Bounds> chunkBounds(std::thread::hardware_concurrency() + 1);
+	std::vector<char> chunkUsed(chunkBounds.size(), 0);
+
+	parallelForChunks(vertexCount, 1 << 14, [&](size_t begin, size_t end, size_t chunk){
+		float minimum[4] = { INFINITY, INFINITY, INFINITY, INFINITY };
+		float maximum[4] = { -INFINITY, -INFINITY, -INFINITY, -INFINITY };
+		float radius = 0;
+
+#ifdef __SSE2__
+		auto column0 = _mm_loadu_ps(matrix);
+		auto column1 = _mm_loadu_ps(matrix + 4);
+		auto column2 = _mm_loadu_ps(matrix + 8);
+		auto column3 = _mm_loadu_ps(matrix + 12);
+		auto minimumVector = _mm_loadu_ps(minimum);
+		auto maximumVector = _mm_loadu_ps(maximum);
+		auto radiusVector = _mm_setzero_ps();
+		auto stepVector = _mm_set1_ps(step);
+		auto inverseStepVector = _mm_set1_ps(step > 0 ? 1 / step : 0);
+
+		for(size_t i = begin; i < end; i++){
+			auto position = positions + i * 3;
+			auto result = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(position[0])), _mm_mul_ps(column1, _mm_set1_ps(position[1]))),
+				_mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(position[2])), column3));
+
+			if(step > 0){
+				result = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(result, inverseStepVector))), stepVector);
+			}
+
+			minimumVector = _mm_min_ps(minimumVector, result);
+			maximumVector = _mm_max_ps(maximumVector, result);
+
+			auto squared = _mm_mul_ps(result, result);
+			auto length = _mm_add_ps(_mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 2, 2, 2)));
+			radiusVector = _mm_max_ss(radiusVector, length);
+
+			float stored[4];
+			_mm_storeu_ps(stored, result);
+			memcpy(position, stored, sizeof(float) * 3);
+		}
+
+		_mm_storeu_ps(minimum, minimumVector);
+		_mm_storeu_ps(maximum, maximumVector);
+		radius = _mm_cvtss_f32(radiusVector);
+#else
+		for(size_t i = begin; i < end; i++){
+			auto position = positions + i * 3;
+			float result[3];
+
+			for(int row = 0; row < 3; row++){
+				result[row] = matrix[row] * position[0] + matrix[4 + row] * position[1] + matrix[8 + row] * position[2] + matrix[12 + row];
+
+				if(step > 0){
+					result[row] = nearbyintf(result[row] / step) * step;
+				}
+
+				minimum[row] = std::min(minimum[row], result[row]);
+				maximum[row] = std::max(maximum[row], result[row]);
+			}
+
+			radius = std::max(radius, result[0] * result[0] + result[1] * result[1] + result[2] * result[2]);
+			memcpy(position, result, sizeof(result));
+		}
+#endif
+
+		auto &bounds = chunkBounds[chunk];
+		memcpy(bounds.minimum, minimum, sizeof(bounds.minimum));
+		memcpy(bounds.maximum, maximum, sizeof(bounds.maximum));
+		bounds.radius = radius;
+		chunkUsed[chunk] = end > begin;
+	});
+
+	Bounds result;
+	bool first = true;
+
+	for(size_t chunk = 0; chunk < chunkBounds.size(); chunk++){
+		if(!chunkUsed[chunk]){
+			continue;
+		}
+
+		auto &bounds = chunkBounds[chunk];
+		for(int i = 0; i < 3; i++){
+			result.minimum[i] = first ? bounds.minimum[i] : std::min(result.minimum[i], bounds.minimum[i]);
+			result.maximum[i] = first ? bounds.maximum[i] : std::max(result.maximum[i], bounds.maximum[i]);
+		}
+		result.radius = std::max(result.radius, bounds.radius);
+		first = false;
+	}
+
+	result.radius = sqrtf(result.radius);
+
+	if(isMirrored()){
+		reverseWindings(mesh);
+	}
+
+	return result;
+}
+
+void Triangulator::getPoint(ExtractedMesh *mesh, int loop, float *point){
+	auto position = &mesh->positions[mesh->loopVertices[loop] * 3];
+	point[0] = position[0];
+	point[1] = position[1];
+	point[2] = position[2];
+}
+
+void Triangulator::project(ExtractedMesh *mesh, int loopStart, int loopCount, std::vector<float> &points){
+	float normal[3] = { 0, 0, 0 };
+	float current[3];
+	float next[3];
+
+	for(int i = 0; i < loopCount; i++){
+		getPoint(mesh, loopStart + i, current);
+		getPoint(mesh, loopStart + (i + 1) % loopCount, next);
+
+		normal[0] += (current[1] - next[1]) * (current[2] + next[2]);
+		normal[1] += (current[2] - next[2]) * (current[0] + next[0]);
+		normal[2] += (current[0] - next[0]) * (current[1] + next[1]);
+	}
+
+	int axis = 2;
+	if(fabsf(normal[0]) > fabsf(normal[1]) && fabsf(normal[0]) > fabsf(normal[2])){
+		axis = 0;
+	} else if(fabsf(normal[1]) > fabsf(normal[2])){
+		axis = 1;
+	}
+
+	int u = (axis + 1) % 3;
+	int v = (axis + 2) % 3;
+	bool flip = normal[axis] < 0;
+
+	points.resize(loopCount * 2);
+	for(int i = 0; i < loopCount; i++){
+		getPoint(mesh, loopStart + i, current);
+		points[i * 2] = current[u];
+		points[i * 2 + 1] = flip ? -current[v] : current[v];
+	}
+}
+
+float Triangulator::cross(const float *a, const float *b, const float *c){
+	return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+bool Triangulator::isConvex(std::vector<float> &points, int count){
+	for(int i = 0; i < count; i++){
+		if(cross(&points[i * 2], &points[(i + 1) % count * 2], &points[(i + 2) % count * 2]) < 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Triangulator::isInside(const float *p, const float *a, const float *b, const float *c){
+	return cross(a, b, p) >= 0 && cross(b, c, p) >= 0 && cross(c, a, p) >= 0;
+}
+
+void Triangulator::fan(int loopStart, int loopCount, int *target){
+	for(int i = 1; i + 1 < loopCount; i++){
+		*target++ = loopStart;
+		*target++ = loopStart + i;
+		*target++ = loopStart + i + 1;
+	}
+}
+
+void Triangulator::clipEars(std::vector<float> &points, int loopStart, int loopCount, int *target){
+	std::vector<int> remaining;
+	for(int i = 0; i < loopCount; i++){
+		remaining.push_back(i);
+	}
+
+	while(remaining.size() > 3){
+		bool clipped = false;
+		int size = remaining.size();
+
+		for(int i = 0; i < size; i++){
+			auto a = &points[remaining[(i + size - 1) % size] * 2];
+			auto b = &points[remaining[i] * 2];
+			auto c = &points[remaining[(i + 1) % size] * 2];
+
+			if(cross(a, b, c) <= 0){
+				continue;
+			}
+
+			bool isEar = true;
+			for(int j = 0; j < size && isEar; j++){
+				if(j == i || j == (i + 1) % size || j == (i + size - 1) % size){
+					continue;
+				}
+				isEar = !isInside(&points[remaining[j] * 2], a, b, c);
+			}
+
+			if(!isEar){
+				continue;
+			}
+
+			*target++ = loopStart + remaining[(i + size - 1) % size];
+			*target++ = loopStart + remaining[i];
+			*target++ = loopStart + remaining[(i + 1) % size];
+			remaining.erase(remaining.begin() + i);
+			clipped = true;
+			break;
+		}
+
+		if(!clipped){
+			break; // degenerate or self-intersecting polygon, fan the rest
+		}
+	}
+
+	for(size_t i = 1; i + 1 < remaining.size(); i++){
+		*target++ = loopStart + remaining[0];
+		*target++ = loopStart + remaining[i];
+		*target++ = loopStart + remaining[i + 1];
+	}
+}
+
+void Triangulator::triangulate(ExtractedMesh *mesh){
+	auto polyCount = mesh->getPolyCount();
+	std::vector<int> offsets(polyCount);
+
+	for(int i = 0; i < polyCount; i++){
+		offsets[i] = std::max(0, mesh->polyLoopCounts[i] - 2) * 3;
+	}
+
+	mesh->triangles.resize(parallelPrefixSum(offsets));
+
+	parallelFor(polyCount, 1 << 12, [mesh, &offsets](size_t begin, size_t end){
+		std::vector<float> points;
+
+		for(size_t i = begin; i < end; i++){
+			auto loopStart = mesh->polyLoopStarts[i];
+			auto loopCount = mesh->polyLoopCounts[i];
+			auto target = mesh->triangles.data() + offsets[i];
+
+			if(loopCount <= 4){
+				if(loopCount == 4){
+					project(mesh, loopStart, loopCount, points);
+					if(!isConvex(points, loopCount)){
+						clipEars(points, loopStart, loopCount, target);
+						continue;
+					}
+				}
+				fan(loopStart, loopCount, target);
+				continue;
+			}
+
+			project(mesh, loopStart, loopCount, points);
+
+			if(isConvex(points, loopCount)){
+				fan(loopStart, loopCount, target);
+			} else {
+				clipEars(points, loopStart, loopCount, target);
+			}
+		}
+	});
+}
+
+#ifdef __SSE2__
+inline __m128 NormalGenerator::cross(__m128 a, __m128 b){
+	auto aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	auto bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	auto c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+	return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+inline __m128 NormalGenerator::normalize(__m128 v){
+	auto squared = _mm_mul_ps(v, v);
+	auto length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_shuffle_ps(squared, squared, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 2, 2, 2))));
+	auto valid = _mm_cmpgt_ps(length, _mm_set1_ps(1e-20f));
+	auto result = _mm_div_ps(v, _mm_or_ps(_mm_and_ps(valid, length), _mm_andnot_ps(valid, _mm_set1_ps(1))));
+	return _mm_or_ps(_mm_and_ps(valid, result), _mm_andnot_ps(valid, _mm_set_ps(0, 1, 0, 0)));
+}
+#endif
+
+inline void NormalGenerator::storeNormalized(const float *vector, float *target){
+#ifdef __SSE2__
+	float normal[4];
+	_mm_storeu_ps(normal, normalize(_mm_loadu_ps(vector)));
+	memcpy(target, normal, sizeof(float) * 3);
+#else
+	float length = sqrtf(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+
+	if(length > 1e-20f){
+		target[0] = vector[0] / length;
+		target[1] = vector[1] / length;
+		target[2] = vector[2] / length;
+	} else {
+		target[0] = 0;
+		target[1] = 0;
+		target[2] = 1;
+	}
+#endif
+}
+
+void NormalGenerator::getFaceNormal(const float *points, const int *loopVertices, int loopCount, float *normal){
+	auto origin = points + loopVertices[0] * 4;
+#ifdef __SSE2__
+	auto originVector = _mm_loadu_ps(origin);
+	auto sum = _mm_setzero_ps();
+	auto previous = _mm_sub_ps(_mm_loadu_ps(points + loopVertices[1] * 4), originVector);
+
+	for(int i = 2; i < loopCount; i++){
+		auto current = _mm_sub_ps(_mm_loadu_ps(points + loopVertices[i] * 4), originVector);
+		sum = _mm_add_ps(sum, cross(previous, current));
+		previous = current;
+	}
+
+	_mm_storeu_ps(normal, sum);
+#else
+	normal[0] = normal[1] = normal[2] = normal[3] = 0;
+
+	for(int i = 2; i < loopCount; i++){
+		auto a = points + loopVertices[i - 1] * 4;
+		auto b = points + loopVertices[i] * 4;
+		float u[3] = { a[0] - origin[0], a[1] - origin[1], a[2] - origin[2] };
+		float v[3] = { b[0] - origin[0], b[1] - origin[1], b[2] - origin[2] };
+
+		normal[0] += u[1] * v[2] - u[2] * v[1];
+		normal[1] += u[2] * v[0] - u[0] * v[2];
+		normal[2] += u[0] * v[1] - u[1] * v[0];
+	}
+#endif
+}
+
+inline void NormalGenerator::add(float *target, const float *value){
+#ifdef __SSE2__
+	_mm_storeu_ps(target, _mm_add_ps(_mm_loadu_ps(target), _mm_loadu_ps(value)));
+#else
+	for(int i = 0; i < 4; i++){
+		target[i] += value[i];
+	}
+#endif
+}
+
+int NormalGenerator::find(std::vector<int> &parents, int loop){
+	while(parents[loop] != loop){
+		parents[loop] = parents[parents[loop]];
+		loop = parents[loop];
+	}
+	return loop;
+}
+
+void NormalGenerator::unite(std::vector<int> &parents, int a, int b){
+	a = find(parents, a);
+	b = find(parents, b);
+	if(a != b){
+		parents[std::max(a, b)] = std::min(a, b);
+	}
+}
+
+bool NormalGenerator::findSmoothFans(ExtractedMesh *mesh, const std::vector<float> &faceNormals, const std::vector<int> &loopPolys, std::vector<int> &parents){
+	auto loopCount = mesh->getLoopCount();
+	auto loopEdges = mesh->loopEdges;
+	bool knownEdges = (int)loopEdges.size() == loopCount;
+
+	auto next = [mesh, &loopPolys](int loop){
+		auto poly = loopPolys[loop];
+		auto start = mesh->polyLoopStarts[poly];
+		return start + (loop - start + 1) % mesh->polyLoopCounts[poly];
+	};
+
+	if(!knownEdges){
+		std::map<std::pair<int, int>, int> edges;
+		loopEdges.resize(loopCount);
+
+		for(int loop = 0; loop < loopCount; loop++){
+			auto a = mesh->loopVertices[loop];
+			auto b = mesh->loopVertices[next(loop)];
+			auto key = std::make_pair(std::min(a, b), std::max(a, b));
+			auto found = edges.find(key);
+
+			if(found == edges.end()){
+				found = edges.insert(std::make_pair(key, (int)edges.size())).first;
+			}
+			loopEdges[loop] = found->second;
+		}
+	}
+
+	int edgeCount = 0;
+	for(auto edge : loopEdges){
+		edgeCount = std::max(edgeCount, edge + 1);
+	}
+
+	std::vector<int> edgeUses(edgeCount, 0);
+	std::vector<int> edgeLoops(edgeCount * 2, -1);
+
+	for(int loop = 0; loop < loopCount; loop++){
+		auto edge = loopEdges[loop];
+		if(edgeUses[edge] < 2){
+			edgeLoops[edge * 2 + edgeUses[edge]] = loop;
+		}
+		edgeUses[edge]++;
+	}
+
+	bool split = false;
+	float cosine = mesh->autoSmoothAngle >= 0 ? cosf(mesh->autoSmoothAngle) : -2;
+
+	parents.resize(loopCount);
+	for(int loop = 0; loop < loopCount; loop++){
+		parents[loop] = loop;
+	}
+
+	for(int edge = 0; edge < edgeCount; edge++){
+		if(edgeUses[edge] == 0){
+			continue;
+		}
+		if(edgeUses[edge] != 2){
+			split |= edgeUses[edge] > 2; // open borders end a fan without splitting it
+			continue;
+		}
+
+		auto a = edgeLoops[edge * 2];
+		auto b = edgeLoops[edge * 2 + 1];
+		auto polyA = loopPolys[a];
+		auto polyB = loopPolys[b];
+		bool sharp = knownEdges && edge < (int)mesh->sharpEdges.size() && mesh->sharpEdges[edge];
+
+		if(!mesh->smoothPolys.empty() && (!mesh->smoothPolys[polyA] || !mesh->smoothPolys[polyB])){
+			sharp = true;
+		}
+		if(mesh->loopVertices[a] != mesh->loopVertices[next(b)]){
+			sharp = true; // the polygons wind in opposite directions
+		}
+		if(!sharp && cosine > -2){
+			float normalA[3], normalB[3];
+			storeNormalized(&faceNormals[polyA * 4], normalA);
+			storeNormalized(&faceNormals[polyB * 4], normalB);
+
+			sharp = normalA[0] * normalB[0] + normalA[1] * normalB[1] + normalA[2] * normalB[2] < cosine;
+		}
+
+		if(sharp){
+			split = true;
+			continue;
+		}
+
+		unite(parents, a, next(b));
+		unite(parents, next(a), b);
+	}
+
+	return split;
+}
+
+void NormalGenerator::generate(ExtractedMesh *mesh){
+	auto vertexCount = mesh->getVertexCount();
+	auto loopCount = mesh->getLoopCount();
+	auto polyCount = mesh->getPolyCount();
+
+	// Positions padded to four floats, so each loads as one vector
+	std::vector<float> points(vertexCount * 4, 0);
+	parallelFor(vertexCount, 1 << 14, [mesh, &points](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			memcpy(&points[i * 4], &mesh->positions[i * 3], sizeof(float) * 3);
+		}
+	});
+
+	std::vector<float> faceNormals(polyCount * 4);
+	std::vector<int> loopPolys(loopCount);
+	parallelFor(polyCount, 1 << 12, [mesh, &points, &faceNormals, &loopPolys](size_t begin, size_t end){
+		for(size_t poly = begin; poly < end; poly++){
+			auto start = mesh->polyLoopStarts[poly];
+			auto count = mesh->polyLoopCounts[poly];
+
+			getFaceNormal(points.data(), &mesh->loopVertices[start], count, &faceNormals[poly * 4]);
+			for(int i = 0; i < count; i++){
+				loopPolys[start + i] = poly;
+			}
+		}
+	});
+
+	std::vector<std::vector<float>> accumulators(std::thread::hardware_concurrency() + 1);
+	parallelForChunks(polyCount, 1 << 12, [mesh, vertexCount, &faceNormals, &accumulators](size_t begin, size_t end, size_t chunk){
+		auto &accumulator = accumulators[chunk];
+		accumulator.resize(vertexCount * 4, 0);
+
+		for(size_t poly = begin; poly < end; poly++){
+			auto start = mesh->polyLoopStarts[poly];
+			for(int i = 0; i < mesh->polyLoopCounts[poly]; i++){
+				add(&accumulator[mesh->loopVertices[start + i] * 4], &faceNormals[poly * 4]);
+			}
+		}
+	});
+
+	mesh->vertexNormals.resize(vertexCount * 3);
+	parallelFor(vertexCount, 1 << 12, [mesh, &accumulators](size_t begin, size_t end){
+		for(size_t vertex = begin; vertex < end; vertex++){
+			float sum[4] = { 0, 0, 0, 0 };
+			for(auto &accumulator : accumulators){
+				if(!accumulator.empty()){
+					add(sum, &accumulator[vertex * 4]);
+				}
+			}
+			storeNormalized(sum, &mesh->vertexNormals[vertex * 3]);
+		}
+	});
+
+	std::vector<int> parents;
+	mesh->loopNormals.resize(loopCount * 3);
+
+	if(!findSmoothFans(mesh, faceNormals, loopPolys, parents)){
+		parallelFor(loopCount, 1 << 14, [mesh](size_t begin, size_t end){
+			for(size_t loop = begin; loop < end; loop++){
+				memcpy(&mesh->loopNormals[loop * 3], &mesh->vertexNormals[mesh->loopVertices[loop] * 3], sizeof(float) * 3);
+			}
+		});
+		return;
+	}
+
+	std::vector<float> fanNormals(loopCount * 4, 0);
+	for(int loop = 0; loop < loopCount; loop++){
+		parents[loop] = find(parents, loop);
+		add(&fanNormals[parents[loop] * 4], &faceNormals[loopPolys[loop] * 4]);
+	}
+
+	parallelFor(loopCount, 1 << 14, [mesh, &parents, &fanNormals](size_t begin, size_t end){
+		for(size_t loop = begin; loop < end; loop++){
+			storeNormalized(&fanNormals[parents[loop] * 4], &mesh->loopNormals[loop * 3]);
+		}
+	});
+}
+
+std::vector<float> NormalGenerator::pack(ExtractedMesh *mesh){
+	std::vector<float> result(mesh->triangles.size() * 3);
+
+	parallelFor(mesh->triangles.size(), 1 << 14, [mesh, &result](size_t begin, size_t end){
+		for(size_t corner = begin; corner < end; corner++){
+			memcpy(&result[corner * 3], &mesh->loopNormals[mesh->triangles[corner] * 3], sizeof(float) * 3);
+		}
+	});
+
+	return result;
+}
+
+void MeshSimplifier::Quadric::addPlane(double a, double b, double c, double d, double weight){
+	q[0] += weight * a * a; q[1] += weight * a * b; q[2] += weight * a * c; q[3] += weight * a * d;
+	q[4] += weight * b * b; q[5] += weight * b * c; q[6] += weight * b * d;
+	q[7] += weight * c * c; q[8] += weight * c * d;
+	q[9] += weight * d * d;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric &other){
+	for(int i = 0; i < 10; i++){
+		q[i] += other.q[i];
+	}
+}
+
+double MeshSimplifier::Quadric::evaluate(const float *p) const {
+	double x = p[0], y = p[1], z = p[2];
+	return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+		+ q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+		+ q[7] * z * z + 2 * q[8] * z
+		+ q[9];
+}
+
+bool MeshSimplifier::Collapse::operator<(const Collapse &other) const {
+	return cost > other.cost; // std::priority_queue pops the largest, we want the cheapest
+}
+
+void MeshSimplifier::getNormal(const float *a, const float *b, const float *c, double *normal){
+	double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	double ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+	normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+	normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+const float* MeshSimplifier::getPosition(int vertex){
+	return &positions[vertex * 3];
+}
+
+int MeshSimplifier::findCorner(int triangle, int vertex){
+	for(int i = 0; i < 3; i++){
+		if(corners[triangle * 3 + i] == vertex){
+			return triangle * 3 + i;
+		}
+	}
+	return -1;
+}
+
+void MeshSimplifier::pushCollapse(int from, int to){
+	if(locked[from]){
+		return;
+	}
+
+	Quadric quadric = quadrics[from];
+	quadric.add(quadrics[to]);
+
+	heap.push(Collapse{ quadric.evaluate(getPosition(to)), from, to, versions[from], versions[to] });
+}
+
+void MeshSimplifier::pushCollapses(int vertex){
+	for(auto triangle : vertexTriangles[vertex]){
+		for(int i = 0; i < 3; i++){
+			auto other = corners[triangle * 3 + i];
+			if(other != vertex){
+				pushCollapse(vertex, other);
+				pushCollapse(other, vertex);
+			}
+		}
+	}
+}
+
+void MeshSimplifier::readShading(ExtractedMesh *mesh){
+	autoSmoothAngle = mesh->autoSmoothAngle;
+	triangleSmooth.assign(triangleCount, 1);
+
+	std::vector<int> loopPolys(mesh->getLoopCount());
+	for(int poly = 0; poly < mesh->getPolyCount(); poly++){
+		for(int i = 0; i < mesh->polyLoopCounts[poly]; i++){
+			loopPolys[mesh->polyLoopStarts[poly] + i] = poly;
+		}
+	}
+
+	if(!mesh->smoothPolys.empty()){
+		for(int triangle = 0; triangle < triangleCount; triangle++){
+			triangleSmooth[triangle] = mesh->smoothPolys[loopPolys[mesh->triangles[triangle * 3]]];
+		}
+	}
+
+	if(mesh->loopEdges.size() != mesh->loopVertices.size()){
+		return;
+	}
+
+	for(int loop = 0; loop < mesh->getLoopCount(); loop++){
+		auto edge = mesh->loopEdges[loop];
+
+		if(edge >= (int)mesh->sharpEdges.size() || !mesh->sharpEdges[edge]){
+			continue;
+		}
+
+		auto poly = loopPolys[loop];
+		auto start = mesh->polyLoopStarts[poly];
+		auto a = mesh->loopVertices[loop];
+		auto b = mesh->loopVertices[start + (loop - start + 1) % mesh->polyLoopCounts[poly]];
+
+		sharpEdges.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+		locked[a] = true;
+		locked[b] = true;
+	}
+}
+
+void MeshSimplifier::getNeighbours(int vertex, std::vector<int> &result){
+	result.clear();
+	for(auto triangle : vertexTriangles[vertex]){
+		for(int i = 0; i < 3; i++){
+			auto other = corners[triangle * 3 + i];
+			if(other != vertex && std::find(result.begin(), result.end(), other) == result.end()){
+				result.push_back(other);
+			}
+		}
+	}
+}
+
+bool MeshSimplifier::canCollapse(int from, int to){
+	int sharedTriangles = 0;
+	for(auto triangle : vertexTriangles[from]){
+		if(findCorner(triangle, to) != -1){
+			sharedTriangles++;
+		}
+	}
+
+	if(sharedTriangles == 0){
+		return false;
+	}
+
+	// link condition: the only neighbours both ends share are the tips of the shared triangles
+	std::vector<int> fromNeighbours;
+	std::vector<int> toNeighbours;
+	getNeighbours(from, fromNeighbours);
+	getNeighbours(to, toNeighbours);
+
+	int sharedNeighbours = 0;
+	for(auto neighbour : fromNeighbours){
+		if(std::find(toNeighbours.begin(), toNeighbours.end(), neighbour) != toNeighbours.end()){
+			sharedNeighbours++;
+		}
+	}
+
+	if(sharedNeighbours != sharedTriangles){
+		return false;
+	}
+
+	// the triangles that stay must not fold over
+	for(auto triangle : vertexTriangles[from]){
+		if(findCorner(triangle, to) != -1){
+			continue;
+		}
+
+		const float *points[3];
+		const float *moved[3];
+		for(int i = 0; i < 3; i++){
+			auto vertex = corners[triangle * 3 + i];
+			points[i] = getPosition(vertex);
+			moved[i] = vertex == from ? getPosition(to) : points[i];
+		}
+
+		double before[3];
+		double after[3];
+		getNormal(points[0], points[1], points[2], before);
+		getNormal(moved[0], moved[1], moved[2], after);
+
+		if(before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MeshSimplifier::collapse(int from, int to){
+	const float *toUV = nullptr;
+	for(auto triangle : vertexTriangles[from]){
+		auto corner = findCorner(triangle, to);
+		if(corner != -1){
+			toUV = &cornerUVs[corner * 2];
+			break;
+		}
+	}
+
+	float uv[2] = { toUV[0], toUV[1] };
+	std::vector<int> removed;
+
+	for(auto triangle : vertexTriangles[from]){
+		if(findCorner(triangle, to) != -1){
+			triangleRemoved[triangle] = true;
+			triangleCount--;
+			removed.push_back(triangle);
+			continue;
+		}
+
+		auto corner = findCorner(triangle, from);
+		corners[corner] = to;
+		cornerUVs[corner * 2] = uv[0];
+		cornerUVs[corner * 2 + 1] = uv[1];
+		vertexTriangles[to].push_back(triangle);
+	}
+
+	vertexTriangles[from].clear();
+
+	// Removed triangles leave the lists of all their corners, so later link and
+	// fold-over tests never see them
+	for(auto triangle : removed){
+		for(int i = 0; i < 3; i++){
+			auto vertex = corners[triangle * 3 + i];
+			if(vertex == from){
+				continue;
+			}
+
+			auto &triangles = vertexTriangles[vertex];
+			triangles.erase(std::remove(triangles.begin(), triangles.end(), triangle), triangles.end());
+		}
+	}
+
+	// Once locks are lifted, the sharp edges of from move with it
+	if(unlocked){
+		std::vector<std::pair<int, int>> moved;
+		for(auto &edge : sharpEdges){
+			if(edge.first == from || edge.second == from){
+				moved.push_back(edge);
+			}
+		}
+		for(auto &edge : moved){
+			auto other = edge.first == from ? edge.second : edge.first;
+			sharpEdges.erase(edge);
+			if(other != to){
+				sharpEdges.insert(std::make_pair(std::min(other, to), std::max(other, to)));
+			}
+		}
+	}
+
+	quadrics[to].add(quadrics[from]);
+
+	std::vector<int> neighbours;
+	getNeighbours(to, neighbours);
+	versions[from]++;
+	versions[to]++;
+	for(auto neighbour : neighbours){
+		versions[neighbour]++;
+	}
+	for(auto neighbour : neighbours){
+		pushCollapses(neighbour);
+	}
+}
+
+MeshSimplifier::MeshSimplifier(ExtractedMesh *mesh){
+	auto vertexCount = mesh->getVertexCount();
+
+	positions = mesh->positions;
+	triangleCount = mesh->getTriangleCount();
+	corners.resize(triangleCount * 3);
+	cornerUVs.resize(triangleCount * 6);
+	triangleRemoved.resize(triangleCount, 0);
+	vertexTriangles.resize(vertexCount);
+	quadrics.resize(vertexCount);
+	locked.resize(vertexCount, 0);
+	versions.resize(vertexCount, 0);
+
+	for(int i = 0; i < triangleCount * 3; i++){
+		auto loop = mesh->triangles[i];
+		corners[i] = mesh->loopVertices[loop];
+		cornerUVs[i * 2] = mesh->uvs[loop * 2];
+		cornerUVs[i * 2 + 1] = mesh->uvs[loop * 2 + 1];
+	}
+
+	readShading(mesh);
+
+	std::map<std::pair<int, int>, int> edgeUses;
+	std::vector<float> vertexUVs(vertexCount * 2);
+	std::vector<char> hasUV(vertexCount, 0);
+
+	for(int triangle = 0; triangle < triangleCount; triangle++){
+		auto corner = &corners[triangle * 3];
+		double normal[3];
+		getNormal(getPosition(corner[0]), getPosition(corner[1]), getPosition(corner[2]), normal);
+
+		double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if(length > 0){
+			auto point = getPosition(corner[0]);
+			double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+			double d = -(a * point[0] + b * point[1] + c * point[2]);
+
+			for(int i = 0; i < 3; i++){
+				quadrics[corner[i]].addPlane(a, b, c, d, length / 2);
+			}
+		}
+
+		for(int i = 0; i < 3; i++){
+			auto vertex = corner[i];
+			auto uv = &cornerUVs[(triangle * 3 + i) * 2];
+
+			vertexTriangles[vertex].push_back(triangle);
+
+			if(!hasUV[vertex]){
+				hasUV[vertex] = true;
+				vertexUVs[vertex * 2] = uv[0];
+				vertexUVs[vertex * 2 + 1] = uv[1];
+			} else if(fabsf(vertexUVs[vertex * 2] - uv[0]) > 1e-6f || fabsf(vertexUVs[vertex * 2 + 1] - uv[1]) > 1e-6f){
+				locked[vertex] = true; // UV seam
+			}
+
+			auto other = corner[(i + 1) % 3];
+			edgeUses[std::make_pair(std::min(vertex, other), std::max(vertex, other))]++;
+		}
+	}
+
+	for(auto &edgeUse : edgeUses){
+		if(edgeUse.second != 2){
+			locked[edgeUse.first.first] = true; // open border or non-manifold edge
+			locked[edgeUse.first.second] = true;
+		}
+	}
+
+	for(int vertex = 0; vertex < vertexCount; vertex++){
+		pushCollapses(vertex);
+	}
+}
+
+std::unique_ptr<ExtractedMesh> MeshSimplifier::simplify(int targetTriangleCount){
+	while(triangleCount > targetTriangleCount){
+		if(heap.empty()){
+			if(unlocked){
+				break;
+			}
+
+			// Borders, seams and sharp edges give way rather than miss the target
+			unlocked = true;
+			locked.assign(locked.size(), 0);
+			for(int vertex = 0; vertex < (int)vertexTriangles.size(); vertex++){
+				pushCollapses(vertex);
+			}
+			continue;
+		}
+
+		auto candidate = heap.top();
+		heap.pop();
+
+		if(candidate.fromVersion != versions[candidate.from] || candidate.toVersion != versions[candidate.to]){
+			continue; // stale, the neighbourhood changed since this was queued
+		}
+		if(!canCollapse(candidate.from, candidate.to)){
+			continue;
+		}
+
+		collapse(candidate.from, candidate.to);
+	}
+
+	auto result = std::unique_ptr<ExtractedMesh>(new ExtractedMesh());
+	std::vector<int> remap(vertexTriangles.size(), -1);
+	std::map<std::pair<int, int>, int> edges;
+
+	result->autoSmoothAngle = autoSmoothAngle;
+
+	for(size_t triangle = 0; triangle < triangleRemoved.size(); triangle++){
+		if(triangleRemoved[triangle]){
+			continue;
+		}
+
+		result->polyLoopStarts.push_back(result->getLoopCount());
+		result->polyLoopCounts.push_back(3);
+		result->smoothPolys.push_back(triangleSmooth[triangle]);
+
+		// Edges are numbered by their vertices in the source mesh, where sharp edges
+		// were recorded; their vertices are locked, or carry their sharp edges along
+		// once the locks are lifted, so they still match
+		for(int i = 0; i < 3; i++){
+			auto a = corners[triangle * 3 + i];
+			auto b = corners[triangle * 3 + (i + 1) % 3];
+			auto key = std::make_pair(std::min(a, b), std::max(a, b));
+			auto found = edges.find(key);
+
+			if(found == edges.end()){
+				found = edges.insert(std::make_pair(key, (int)edges.size())).first;
+				result->sharpEdges.push_back(sharpEdges.count(key) > 0);
+			}
+			result->loopEdges.push_back(found->second);
+		}
+
+		for(int i = 0; i < 3; i++){
+			auto vertex = corners[triangle * 3 + i];
+
+			if(remap[vertex] == -1){
+				remap[vertex] = result->getVertexCount();
+				result->positions.insert(result->positions.end(), getPosition(vertex), getPosition(vertex) + 3);
+			}
+
+			result->triangles.push_back(result->getLoopCount());
+			result->loopVertices.push_back(remap[vertex]);
+			result->uvs.push_back(cornerUVs[(triangle * 3 + i) * 2]);
+			result->uvs.push_back(cornerUVs[(triangle * 3 + i) * 2 + 1]);
+		}
+	}
+
+	return result;
+}
+
+std::vector<std::vector<std::unique_ptr<ExtractedMesh>>> LodGenerator::generate(std::vector<ExtractedMesh*> meshes, std::vector<int> targetTriangleCounts){
+	std::vector<std::vector<std::unique_ptr<ExtractedMesh>>> result(meshes.size());
+
+	parallelFor(meshes.size(), 1, [&meshes, &targetTriangleCounts, &result](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			ExtractedMesh *previous = meshes[i];
+
+			for(auto target : targetTriangleCounts){
+				auto level = MeshSimplifier(previous).simplify(target);
+				level->name = meshes[i]->name;
+				result[i].push_back(std::move(level));
+				previous = &*result[i].back();
+			}
+		}
+	});
+
+	return result;
+}
+
+float VertexCacheOptimizer::getVertexScore(int cachePosition, int remainingTriangles){
+	if(remainingTriangles == 0){
+		return -1;
+	}
+
+	float score = 0;
+
+	if(cachePosition >= 0){
+		if(cachePosition < 3){
+			score = 0.75f; // the last triangle's vertices, keep them from winning outright
+		} else {
+			score = powf(1.0f - (float)(cachePosition - 3) / (cacheSize - 3), 1.5f);
+		}
+	}
+
+	return score + 2.0f * powf((float)remainingTriangles, -0.5f);
+}
+
+std::vector<int> VertexCacheOptimizer::getTriangleVertices(ExtractedMesh *mesh){
+	std::vector<int> result(mesh->triangles.size());
+
+	for(size_t i = 0; i < mesh->triangles.size(); i++){
+		result[i] = mesh->loopVertices[mesh->triangles[i]];
+	}
+
+	return result;
+}
+
+float VertexCacheOptimizer::getACMR(ExtractedMesh *mesh, int fifoSize){
+	auto vertices = getTriangleVertices(mesh);
+
+	if(vertices.empty()){
+		return 0;
+	}
+
+	std::vector<int> fifo;
+	int misses = 0;
+
+	for(auto vertex : vertices){
+		if(std::find(fifo.begin(), fifo.end(), vertex) != fifo.end()){
+			continue;
+		}
+
+		misses++;
+		fifo.push_back(vertex);
+
+		if((int)fifo.size() > fifoSize){
+			fifo.erase(fifo.begin());
+		}
+	}
+
+	return (float)misses / (vertices.size() / 3);
+}
+
+void VertexCacheOptimizer::optimize(ExtractedMesh *mesh){
+	auto triangleCount = mesh->getTriangleCount();
+	auto vertexCount = mesh->getVertexCount();
+	auto vertices = getTriangleVertices(mesh);
+
+	std::vector<int> remainingTriangles(vertexCount, 0);
+	for(auto vertex : vertices){
+		remainingTriangles[vertex]++;
+	}
+
+	std::vector<int> vertexTriangleStarts(vertexCount + 1, 0);
+	for(int i = 0; i < vertexCount; i++){
+		vertexTriangleStarts[i + 1] = vertexTriangleStarts[i] + remainingTriangles[i];
+	}
+
+	std::vector<int> vertexTriangles(vertices.size());
+	std::vector<int> filled(vertexCount, 0);
+	for(size_t i = 0; i < vertices.size(); i++){
+		auto vertex = vertices[i];
+		vertexTriangles[vertexTriangleStarts[vertex] + filled[vertex]++] = i / 3;
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for(int i = 0; i < vertexCount; i++){
+		vertexScores[i] = getVertexScore(-1, remainingTriangles[i]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<char> triangleAdded(triangleCount, 0);
+	for(int i = 0; i < triangleCount; i++){
+		triangleScores[i] = vertexScores[vertices[i * 3]] + vertexScores[vertices[i * 3 + 1]] + vertexScores[vertices[i * 3 + 2]];
+	}
+
+	std::vector<int> cache;
+	std::vector<int> order;
+	order.reserve(triangleCount);
+	int scanPosition = 0;
+	int bestTriangle = -1;
+
+	while((int)order.size() < triangleCount){
+		if(bestTriangle == -1){
+			// nothing in the cache is usable, take the best triangle left anywhere
+			float bestScore = -1;
+			for(; scanPosition < triangleCount && triangleAdded[scanPosition]; scanPosition++){
+			}
+			for(int i = scanPosition; i < triangleCount; i++){
+				if(!triangleAdded[i] && triangleScores[i] > bestScore){
+					bestScore = triangleScores[i];
+					bestTriangle = i;
+				}
+			}
+		}
+
+		triangleAdded[bestTriangle] = true;
+		order.push_back(bestTriangle);
+
+		std::vector<int> newCache;
+		for(int i = 0; i < 3; i++){
+			auto vertex = vertices[bestTriangle * 3 + i];
+			newCache.push_back(vertex);
+
+			// drop the triangle from the vertex's list of remaining triangles
+			auto begin = vertexTriangles.begin() + vertexTriangleStarts[vertex];
+			auto end = begin + remainingTriangles[vertex];
+			auto position = std::find(begin, end, bestTriangle);
+			std::iter_swap(position, end - 1);
+			remainingTriangles[vertex]--;
+		}
+		for(auto vertex : cache){
+			if(std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()){
+				newCache.push_back(vertex);
+			}
+		}
+
+		for(size_t i = cacheSize; i < newCache.size(); i++){
+			cachePositions[newCache[i]] = -1;
+			vertexScores[newCache[i]] = getVertexScore(-1, remainingTriangles[newCache[i]]);
+		}
+		if((int)newCache.size() > cacheSize){
+			newCache.resize(cacheSize);
+		}
+		cache = newCache;
+
+		for(size_t i = 0; i < cache.size(); i++){
+			cachePositions[cache[i]] = i;
+			vertexScores[cache[i]] = getVertexScore(i, remainingTriangles[cache[i]]);
+		}
+
+		bestTriangle = -1;
+		float bestScore = -1;
+
+		for(auto vertex : cache){
+			for(int i = 0; i < remainingTriangles[vertex]; i++){
+				auto triangle = vertexTriangles[vertexTriangleStarts[vertex] + i];
+				auto score = vertexScores[vertices[triangle * 3]] + vertexScores[vertices[triangle * 3 + 1]] + vertexScores[vertices[triangle * 3 + 2]];
+				triangleScores[triangle] = score;
+
+				if(score > bestScore){
+					bestScore = score;
+					bestTriangle = triangle;
+				}
+			}
+		}
+	}
+
+	std::vector<int> triangles(mesh->triangles.size());
+	for(int i = 0; i < triangleCount; i++){
+		memcpy(&triangles[i * 3], &mesh->triangles[order[i] * 3], sizeof(int) * 3);
+	}
+	mesh->triangles = triangles;
+
+	// vertex fetch order
+	std::vector<int> remap(vertexCount, -1);
+	std::vector<float> positions;
+	positions.reserve(mesh->positions.size());
+
+	for(auto loop : mesh->triangles){
+		auto vertex = mesh->loopVertices[loop];
+		if(remap[vertex] == -1){
+			remap[vertex] = positions.size() / 3;
+			positions.insert(positions.end(), &mesh->positions[vertex * 3], &mesh->positions[vertex * 3] + 3);
+		}
+	}
+	for(int vertex = 0; vertex < vertexCount; vertex++){
+		if(remap[vertex] == -1){
+			remap[vertex] = positions.size() / 3;
+			positions.insert(positions.end(), &mesh->positions[vertex * 3], &mesh->positions[vertex * 3] + 3);
+		}
+	}
+
+	if(!mesh->vertexNormals.empty()){
+		std::vector<float> normals(mesh->vertexNormals.size());
+		for(int vertex = 0; vertex < vertexCount; vertex++){
+			memcpy(&normals[remap[vertex] * 3], &mesh->vertexNormals[vertex * 3], sizeof(float) * 3);
+		}
+		mesh->vertexNormals = normals;
+	}
+
+	mesh->positions = positions;
+	for(auto &vertex : mesh->loopVertices){
+		vertex = remap[vertex];
+	}
+}
+
+float AnimationCurve::bezier(float a, float b, float c, float d, float t){
+	float s = 1 - t;
+	return s * s * s * a + 3 * s * s * t * b + 3 * s * t * t * c + t * t * t * d;
+}
+
+AnimationCurve::AnimationCurve(std::string path, int arrayIndex){
+	this->path = path;
+	this->arrayIndex = arrayIndex;
+}
+
+void AnimationCurve::addKey(const float vec[9], char interpolation){
+	for(int row = 0; row < 3; row++){
+		points.push_back(vec[row * 3]);
+		points.push_back(vec[row * 3 + 1]);
+	}
+	interpolations.push_back(interpolation);
+}
+
+float AnimationCurve::evaluate(float frame) const {
+	int count = interpolations.size();
+
+	if(count == 0){
+		return 0;
+	}
+	if(frame <= points[2]){
+		return points[3];
+	}
+	if(frame >= points[(count - 1) * 6 + 2]){
+		return points[(count - 1) * 6 + 3];
+	}
+
+	int key = 0;
+	while(frame >= points[(key + 1) * 6 + 2]){
+		key++;
+	}
+
+	auto a = &points[key * 6];
+	auto b = &points[(key + 1) * 6];
+
+	if(interpolations[key] == BEZT_IPO_CONST){
+		return a[3];
+	}
+	if(interpolations[key] == BEZT_IPO_LIN){
+		return a[3] + (b[3] - a[3]) * (frame - a[2]) / (b[2] - a[2]);
+	}
+
+	// Blender keeps the handles from overshooting in time, so x(t) is monotonic and
+	// can be inverted by bisection
+	float low = 0;
+	float high = 1;
+	for(int i = 0; i < 24; i++){
+		float t = (low + high) / 2;
+
+		if(bezier(a[2], a[4], b[0], b[2], t) < frame){
+			low = t;
+		} else {
+			high = t;
+		}
+	}
+
+	return bezier(a[3], a[5], b[1], b[3], (low + high) / 2);
+}
+
+ActionReader::ActionReader(PointedDataProvider *pointedDataProvider){
+	this->pointedDataProvider = pointedDataProvider;
+}
+
+std::vector<AnimationCurve> ActionReader::read(const DataPart &id){
+	std::vector<AnimationCurve> result;
+
+	if(id.getPointer("*adt") == 0){
+		return result;
+	}
+
+	auto animData = pointedDataProvider->getPointedData(id, "*adt");
+
+	if(animData.getPointer("*action") == 0){
+		return result;
+	}
+
+	auto action = pointedDataProvider->getPointedData(animData, "*action");
+
+	for(auto fcurve : pointedDataProvider->getList(action, "curves")){
+		size_t size;
+		auto rnaPath = pointedDataProvider->getPointedBytes(fcurve, "*rna_path", size);
+
+		if(rnaPath == nullptr){
+			continue;
+		}
+
+		AnimationCurve curve(std::string(rnaPath, strnlen(rnaPath, size)), fcurve.getInt("array_index"));
+		auto keyCount = fcurve.getInt("totvert");
+		auto keys = pointedDataProvider->getPointedArray(fcurve, "*bezt");
+
+		if(keyCount > 0 && (keys.data == nullptr || keys.count < keyCount)){
+			throw std::runtime_error(std::string("F-Curve ") + curve.path + " holds fewer keyframes than expected");
+		}
+
+		auto vecOffset = keys.type ? keys.type->getOffset("vec") : 0;
+		auto ipoOffset = keys.type ? keys.type->getOffset("ipo") : 0;
+
+		for(int i = 0; i < keyCount; i++){
+			auto key = keys.data + i * keys.type->size;
+			float vec[9];
+
+			memcpy(vec, key + vecOffset, sizeof(vec));
+			curve.addKey(vec, key[ipoOffset]);
+		}
+
+		result.push_back(std::move(curve));
+	}
+
+	return result;
+}
+
+ShapeKeyEvaluator::ShapeKeyEvaluator(PointedDataProvider *pointedDataProvider, const DataPart &mesh){
+	reference = 0;
+	relative = false;
+
+	if(!mesh.type->hasPath("*key") || mesh.getPointer("*key") == 0){
+		return;
+	}
+
+	// The reference key (refkey) is always the first block, "Basis" by default
+	auto key = pointedDataProvider->getPointedData(mesh, "*key");
+	relative = key.getChar("type") == KEY_RELATIVE;
+
+	for(auto block : pointedDataProvider->getList(key, "block")){
+		size_t size;
+		auto data = pointedDataProvider->getPointedBytes(block, "*data", size);
+		auto count = block.getInt("totelem");
+
+		if(data == nullptr || size < count * sizeof(float) * 3){
+			throw std::runtime_error(std::string("Shape key ") + block.getString("name").c_str() + " holds fewer positions than expected");
+		}
+
+		names.push_back(block.getString("name").c_str());
+		positions.push_back(std::vector<float>((const float*)data, (const float*)data + count * 3));
+		relativeTo.push_back(block.getShort("relative"));
+		values.push_back(block.getFloat("curval"));
+		muted.push_back(block.getShort("flag") & KEYBLOCK_MUTE);
+	}
+
+	curves = ActionReader(pointedDataProvider).read(key);
+}
+
+bool ShapeKeyEvaluator::hasKeys(){
+	return !positions.empty();
+}
+
+std::vector<float> ShapeKeyEvaluator::evaluate(float frame){
+	auto weights = values;
+
+	for(auto &curve : curves){
+		for(size_t i = 0; i < names.size(); i++){
+			if(curve.path == std::string("key_blocks[\"") + names[i] + "\"].value"){
+				weights[i] = curve.evaluate(frame);
+			}
+		}
+	}
+
+	auto result = positions[reference];
+
+	if(!relative){
+		return result;
+	}
+
+	for(size_t i = 0; i < positions.size(); i++){
+		int base = relativeTo[i] >= 0 && relativeTo[i] < (int)positions.size() ? relativeTo[i] : reference;
+
+		if((int)i == reference || muted[i] || weights[i] == 0 || positions[i].size() != result.size()){
+			continue;
+		}
+
+		auto &target = positions[i];
+		auto &source = positions[base];
+		auto weight = weights[i];
+
+		for(size_t j = 0; j < result.size(); j++){
+			result[j] += weight * (target[j] - source[j]);
+		}
+	}
+
+	return result;
+}
+
+void AnimationTrack::transform(float scale){
+	for(auto &frame : frames){
+		AnimationFrame source = frame;
+
+		frame.location[0] = scale * source.location[0];
+		frame.location[1] = scale * source.location[2];
+		frame.location[2] = -scale * source.location[1];
+		frame.rotation[1] = source.rotation[2];
+		frame.rotation[2] = -source.rotation[1];
+		frame.scale[1] = source.scale[2];
+		frame.scale[2] = source.scale[1];
+	}
+}
+
+ObjectAnimator::ObjectAnimator(PointedDataProvider *pointedDataProvider, const DataPart &object){
+	for(int i = 0; i < 3; i++){
+		base.location[i] = object.getFloat("loc", i);
+		base.rotation[i] = object.getFloat("rot", i);
+		base.scale[i] = object.getFloat("size", i);
+	}
+
+	curves = ActionReader(pointedDataProvider).read(object);
+}
+
+bool ObjectAnimator::isAnimated(){
+	return !curves.empty();
+}
+
+AnimationFrame ObjectAnimator::evaluate(float frame) const {
+	auto result = base;
+
+	for(auto &curve : curves){
+		if(curve.arrayIndex < 0 || curve.arrayIndex > 2){
+			continue;
+		}
+
+		if(curve.path == "location"){
+			result.location[curve.arrayIndex] = curve.evaluate(frame);
+		} else if(curve.path == "rotation_euler"){
+			result.rotation[curve.arrayIndex] = curve.evaluate(frame);
+		} else if(curve.path == "scale"){
+			result.scale[curve.arrayIndex] = curve.evaluate(frame);
+		}
+	}
+
+	return result;
+}
+
+AnimationTrack ObjectAnimator::evaluate(int frameStart, int frameEnd, float framesPerSecond) const {
+	AnimationTrack result;
+	result.frameTime = (int)lrintf(1000 / framesPerSecond);
+	result.frames.resize(std::max(frameEnd - frameStart + 1, 0));
+
+	parallelFor(result.frames.size(), 64, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			result.frames[i] = evaluate(frameStart + i);
+		}
+	});
+
+	return result;
+}
+
+bool ModifierEvaluator::CopyTransform::isMirrored() const {
+	return scale[0] * scale[1] * scale[2] < 0;
+}
+
+int ModifierEvaluator::getEdgeCount(ExtractedMesh *mesh){
+	int result = mesh->sharpEdges.size();
+	for(auto edge : mesh->loopEdges){
+		result = std::max(result, edge + 1);
+	}
+	return result;
+}
+
+void ModifierEvaluator::replicate(ExtractedMesh *mesh, const std::vector<CopyTransform> &copies){
+	int vertexCount = mesh->getVertexCount();
+	int loopCount = mesh->getLoopCount();
+	int polyCount = mesh->getPolyCount();
+	int edgeCount = getEdgeCount(mesh);
+	int copyCount = copies.size();
+	bool hasEdges = mesh->loopEdges.size() == (size_t)loopCount;
+
+	mesh->positions.resize(vertexCount * copyCount * 3);
+	mesh->loopVertices.resize(loopCount * copyCount);
+	mesh->uvs.resize(loopCount * copyCount * 2);
+	mesh->polyLoopStarts.resize(polyCount * copyCount);
+	mesh->polyLoopCounts.resize(polyCount * copyCount);
+	if(hasEdges){
+		mesh->loopEdges.resize(loopCount * copyCount);
+	}
+	if(!mesh->sharpEdges.empty()){
+		mesh->sharpEdges.resize(edgeCount * copyCount);
+	}
+	if(!mesh->smoothPolys.empty()){
+		mesh->smoothPolys.resize(polyCount * copyCount);
+	}
+
+	size_t copiedVertices = (size_t)vertexCount * (copyCount - 1);
+	size_t copiedPolys = (size_t)polyCount * (copyCount - 1);
+
+	parallelFor(copiedVertices, 1 << 14, [&](size_t begin, size_t end){
+		auto positions = mesh->positions.data();
+
+		for(size_t i = begin; i < end; i++){
+			auto copy = 1 + i / vertexCount;
+			auto &transform = copies[copy];
+			auto source = positions + (i % vertexCount) * 3;
+			auto target = positions + (vertexCount + i) * 3;
+
+			for(int j = 0; j < 3; j++){
+				target[j] = source[j] * transform.scale[j] + transform.offset[j];
+			}
+		}
+	});
+
+	parallelFor(copiedPolys, 1 << 12, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			auto copy = 1 + i / polyCount;
+			auto poly = i % polyCount;
+			auto &transform = copies[copy];
+			bool mirrored = transform.isMirrored();
+			auto start = mesh->polyLoopStarts[poly];
+			auto count = mesh->polyLoopCounts[poly];
+			auto targetStart = start + copy * loopCount;
+
+			mesh->polyLoopStarts[polyCount + i] = targetStart;
+			mesh->polyLoopCounts[polyCount + i] = count;
+			if(!mesh->smoothPolys.empty()){
+				mesh->smoothPolys[polyCount + i] = mesh->smoothPolys[poly];
+			}
+
+			for(int j = 0; j < count; j++){
+				// The edge of a loop leads to the next loop, which is the previous edge of
+				// the reversed order
+				auto from = start + (mirrored ? (count - j) % count : j);
+				auto target = targetStart + j;
+
+				mesh->loopVertices[target] = mesh->loopVertices[from] + copy * vertexCount;
+				mesh->uvs[target * 2] = mesh->uvs[from * 2] * transform.uvScale[0] + transform.uvOffset[0];
+				mesh->uvs[target * 2 + 1] = mesh->uvs[from * 2 + 1] * transform.uvScale[1] + transform.uvOffset[1];
+
+				if(hasEdges){
+					auto edgeFrom = start + (mirrored ? (2 * count - j - 1) % count : j);
+					mesh->loopEdges[target] = mesh->loopEdges[edgeFrom] + copy * edgeCount;
+				}
+			}
+		}
+	});
+
+	for(int copy = 1; copy < copyCount && !mesh->sharpEdges.empty(); copy++){
+		std::copy(mesh->sharpEdges.begin(), mesh->sharpEdges.begin() + edgeCount, mesh->sharpEdges.begin() + copy * edgeCount);
+	}
+}
+
+std::vector<int> ModifierEvaluator::findDoubles(ExtractedMesh *mesh, int from, int to, int count, float distance){
+	auto positions = mesh->positions.data();
+	float cellSize = std::max(distance, 1e-6f);
+	std::unordered_map<unsigned long long, std::vector<int>> cells;
+
+	auto getCell = [cellSize](const float *position, int dx, int dy, int dz){
+		auto x = (unsigned long long)(long long)(floorf(position[0] / cellSize) + dx) & 0x1fffff;
+		auto y = (unsigned long long)(long long)(floorf(position[1] / cellSize) + dy) & 0x1fffff;
+		auto z = (unsigned long long)(long long)(floorf(position[2] / cellSize) + dz) & 0x1fffff;
+		return x << 42 | y << 21 | z;
+	};
+
+	for(int i = 0; i < count; i++){
+		cells[getCell(positions + (from + i) * 3, 0, 0, 0)].push_back(from + i);
+	}
+
+	std::vector<int> result(count, -1);
+
+	parallelFor(count, 1 << 12, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			auto position = positions + (to + i) * 3;
+			float best = distance * distance;
+
+			for(int cell = 0; cell < 27; cell++){
+				auto found = cells.find(getCell(position, cell % 3 - 1, cell / 3 % 3 - 1, cell / 9 - 1));
+				if(found == cells.end()){
+					continue;
+				}
+
+				for(auto candidate : found->second){
+					auto other = positions + candidate * 3;
+					float dx = other[0] - position[0], dy = other[1] - position[1], dz = other[2] - position[2];
+					float squared = dx * dx + dy * dy + dz * dz;
+
+					if(squared <= best && (result[i] < 0 || squared < best || candidate < result[i])){
+						best = squared;
+						result[i] = candidate;
+					}
+				}
+			}
+		}
+	});
+
+	return result;
+}
+
+void ModifierEvaluator::weld(ExtractedMesh *mesh, std::vector<int> &targets){
+	int vertexCount = mesh->getVertexCount();
+	int polyCount = mesh->getPolyCount();
+	bool hasEdges = mesh->loopEdges.size() == mesh->loopVertices.size();
+	std::vector<int> indices(vertexCount);
+	int kept = 0;
+
+	for(int i = 0; i < vertexCount; i++){
+		targets[i] = targets[targets[i]];
+		indices[i] = targets[i] == i ? kept++ : indices[targets[i]];
+	}
+
+	if(kept == vertexCount){
+		return;
+	}
+
+	std::vector<float> positions(kept * 3);
+	parallelFor(vertexCount, 1 << 14, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			if(targets[i] == (int)i){
+				memcpy(&positions[indices[i] * 3], &mesh->positions[i * 3], sizeof(float) * 3);
+			}
+		}
+	});
+
+	auto isCollapsed = [mesh, &indices](int poly, int j){
+		auto start = mesh->polyLoopStarts[poly];
+		auto count = mesh->polyLoopCounts[poly];
+		return indices[mesh->loopVertices[start + j]] == indices[mesh->loopVertices[start + (j + 1) % count]];
+	};
+
+	std::vector<int> loopCounts(polyCount);
+	parallelFor(polyCount, 1 << 12, [&](size_t begin, size_t end){
+		for(size_t poly = begin; poly < end; poly++){
+			int count = 0;
+			for(int j = 0; j < mesh->polyLoopCounts[poly]; j++){
+				count += !isCollapsed(poly, j);
+			}
+			loopCounts[poly] = count >= 3 ? count : 0;
+		}
+	});
+
+	std::vector<int> loopStarts = loopCounts;
+	std::vector<int> polyIndices(polyCount);
+	for(int poly = 0; poly < polyCount; poly++){
+		polyIndices[poly] = loopCounts[poly] > 0;
+	}
+	auto loopCount = parallelPrefixSum(loopStarts);
+	auto keptPolys = parallelPrefixSum(polyIndices);
+
+	ExtractedMesh result;
+	result.loopVertices.resize(loopCount);
+	result.uvs.resize(loopCount * 2);
+	result.polyLoopStarts.resize(keptPolys);
+	result.polyLoopCounts.resize(keptPolys);
+	std::vector<std::pair<int, int>> loopEdgeVertices(hasEdges ? loopCount : 0);
+	std::vector<int> oldLoopEdges(hasEdges ? loopCount : 0);
+	if(!mesh->smoothPolys.empty()){
+		result.smoothPolys.resize(keptPolys);
+	}
+
+	parallelFor(polyCount, 1 << 12, [&](size_t begin, size_t end){
+		for(size_t poly = begin; poly < end; poly++){
+			if(loopCounts[poly] == 0){
+				continue;
+			}
+
+			auto start = mesh->polyLoopStarts[poly];
+			auto target = loopStarts[poly];
+			auto newPoly = polyIndices[poly];
+
+			result.polyLoopStarts[newPoly] = target;
+			result.polyLoopCounts[newPoly] = loopCounts[poly];
+			if(!mesh->smoothPolys.empty()){
+				result.smoothPolys[newPoly] = mesh->smoothPolys[poly];
+			}
+
+			for(int j = 0; j < mesh->polyLoopCounts[poly]; j++){
+				if(isCollapsed(poly, j)){
+					continue;
+				}
+
+				result.loopVertices[target] = indices[mesh->loopVertices[start + j]];
+				result.uvs[target * 2] = mesh->uvs[(start + j) * 2];
+				result.uvs[target * 2 + 1] = mesh->uvs[(start + j) * 2 + 1];
+				if(hasEdges){
+					oldLoopEdges[target] = mesh->loopEdges[start + j];
+				}
+				target++;
+			}
+
+			// A loop's edge runs to the next kept loop
+			for(int j = 0; hasEdges && j < loopCounts[poly]; j++){
+				auto loop = loopStarts[poly] + j;
+				auto a = result.loopVertices[loop];
+				auto b = result.loopVertices[loopStarts[poly] + (j + 1) % loopCounts[poly]];
+				loopEdgeVertices[loop] = std::make_pair(std::min(a, b), std::max(a, b));
+			}
+		}
+	});
+
+	if(hasEdges){
+		std::map<std::pair<int, int>, int> edges;
+		result.loopEdges.resize(loopCount);
+
+		for(int loop = 0; loop < loopCount; loop++){
+			auto found = edges.insert(std::make_pair(loopEdgeVertices[loop], (int)edges.size())).first;
+			result.loopEdges[loop] = found->second;
+		}
+
+		if(!mesh->sharpEdges.empty()){
+			result.sharpEdges.resize(edges.size(), 0);
+			for(int loop = 0; loop < loopCount; loop++){
+				auto oldEdge = oldLoopEdges[loop];
+				if(oldEdge < (int)mesh->sharpEdges.size() && mesh->sharpEdges[oldEdge]){
+					result.sharpEdges[result.loopEdges[loop]] = 1;
+				}
+			}
+		}
+	}
+
+	mesh->positions = std::move(positions);
+	mesh->loopVertices = std::move(result.loopVertices);
+	mesh->uvs = std::move(result.uvs);
+	mesh->polyLoopStarts = std::move(result.polyLoopStarts);
+	mesh->polyLoopCounts = std::move(result.polyLoopCounts);
+	mesh->loopEdges = std::move(result.loopEdges);
+	mesh->sharpEdges = std::move(result.sharpEdges);
+	mesh->smoothPolys = std::move(result.smoothPolys);
+}
+
+void ModifierEvaluator::mirror(ExtractedMesh *mesh, const DataPart &modifier){
+	auto flag = modifier.getShort("flag");
+	auto tolerance = modifier.getFloat("tolerance");
+
+	if(modifier.getPointer("*mirror_ob") != 0){
+		warnings->add("%s mirrors about its own origin instead of the mirror object", objectName.c_str());
+	}
+
+	// Every axis doubles what the previous ones made
+	for(int axis = 0; axis < 3; axis++){
+		if(!(flag & (MOD_MIR_AXIS_X << axis))){
+			continue;
+		}
+
+		int vertexCount = mesh->getVertexCount();
+		std::vector<CopyTransform> copies(2);
+		auto &mirrored = copies[1];
+
+		mirrored.scale[axis] = -1;
+		mirrored.uvOffset[0] = modifier.getFloat("uv_offset_copy", 0);
+		mirrored.uvOffset[1] = -modifier.getFloat("uv_offset_copy", 1);
+		if(flag & MOD_MIR_MIRROR_U){
+			mirrored.uvScale[0] = -1;
+			mirrored.uvOffset[0] += 1 + modifier.getFloat("uv_offset", 0);
+		}
+		if(flag & MOD_MIR_MIRROR_V){
+			mirrored.uvScale[1] = -1;
+			mirrored.uvOffset[1] += 1 - modifier.getFloat("uv_offset", 1);
+		}
+
+		replicate(mesh, copies);
+
+		if(flag & MOD_MIR_NO_MERGE){
+			continue;
+		}
+
+		// A vertex merges with its own mirror image when that is close enough
+		std::vector<int> targets(vertexCount * 2);
+		for(int i = 0; i < vertexCount * 2; i++){
+			targets[i] = i;
+		}
+		for(int i = 0; i < vertexCount; i++){
+			if(fabsf(mesh->positions[i * 3 + axis] * 2) <= tolerance){
+				targets[vertexCount + i] = i;
+			}
+		}
+
+		weld(mesh, targets);
+	}
+}
+
+void ModifierEvaluator::array(ExtractedMesh *mesh, const DataPart &modifier){
+	auto offsetType = modifier.getInt("offset_type");
+	auto flags = modifier.getInt("flags");
+	auto count = modifier.getInt("count");
+	auto vertexCount = mesh->getVertexCount();
+	float step[3] = { 0, 0, 0 };
+
+	if(vertexCount == 0){
+		return;
+	}
+	if(offsetType & MOD_ARR_OFF_OBJ){
+		warnings->add("%s ignores the offset object of its array", objectName.c_str());
+	}
+	if(modifier.getPointer("*start_cap") != 0 || modifier.getPointer("*end_cap") != 0 || modifier.getPointer("*curve_ob") != 0){
+		warnings->add("%s ignores the caps and curve of its array", objectName.c_str());
+	}
+
+	for(int i = 0; i < 3; i++){
+		if(offsetType & MOD_ARR_OFF_CONST){
+			step[i] += modifier.getFloat("offset", i);
+		}
+		if(offsetType & MOD_ARR_OFF_RELATIVE){
+			float minimum = mesh->positions[i], maximum = mesh->positions[i];
+			for(int j = 1; j < vertexCount; j++){
+				minimum = std::min(minimum, mesh->positions[j * 3 + i]);
+				maximum = std::max(maximum, mesh->positions[j * 3 + i]);
+			}
+			step[i] += modifier.getFloat("scale", i) * (maximum - minimum);
+		}
+	}
+
+	if(modifier.getInt("fit_type") == MOD_ARR_FITLENGTH){
+		auto distance = sqrtf(step[0] * step[0] + step[1] * step[1] + step[2] * step[2]);
+		count = distance > 1e-6f ? (int)((modifier.getFloat("length") + 1e-6f) / distance) + 1 : 1;
+	}
+	if(count <= 1){
+		return;
+	}
+
+	std::vector<CopyTransform> copies(count);
+	for(int copy = 1; copy < count; copy++){
+		for(int i = 0; i < 3; i++){
+			copies[copy].offset[i] = step[i] * copy;
+		}
+		copies[copy].uvOffset[0] = modifier.getFloat("uv_offset", 0) * copy;
+		copies[copy].uvOffset[1] = -modifier.getFloat("uv_offset", 1) * copy;
+	}
+
+	replicate(mesh, copies);
+
+	if(!(flags & (MOD_ARR_MERGE | MOD_ARR_MERGEFINAL))){
+		return;
+	}
+
+	auto distance = modifier.getFloat("merge_dist");
+	std::vector<int> targets(vertexCount * count);
+	for(int i = 0; i < vertexCount * count; i++){
+		targets[i] = i;
+	}
+
+	// Every copy is the previous one moved by the same step, so the doubles between
+	// the first two copies are the doubles between any two neighbours
+	if(flags & MOD_ARR_MERGE){
+		auto doubles = findDoubles(mesh, 0, vertexCount, vertexCount, distance);
+
+		for(int copy = 1; copy < count; copy++){
+			for(int i = 0; i < vertexCount; i++){
+				if(doubles[i] >= 0){
+					targets[copy * vertexCount + i] = (copy - 1) * vertexCount + doubles[i];
+				}
+			}
+		}
+	}
+	if(flags & MOD_ARR_MERGEFINAL){
+		auto doubles = findDoubles(mesh, 0, (count - 1) * vertexCount, vertexCount, distance);
+
+		for(int i = 0; i < vertexCount; i++){
+			auto vertex = (count - 1) * vertexCount + i;
+			if(doubles[i] >= 0 && targets[vertex] == vertex){
+				targets[vertex] = doubles[i];
+			}
+		}
+	}
+
+	weld(mesh, targets);
+}
+
+ModifierEvaluator::ModifierEvaluator(PointedDataProvider *pointedDataProvider, const DataPart &object, WarningLog *warnings){
+	this->pointedDataProvider = pointedDataProvider;
+	this->object = object;
+	this->warnings = warnings;
+	this->objectName = object.getString("id.name").c_str() + 2;
+}
+
+void ModifierEvaluator::evaluate(ExtractedMesh *mesh){
+	for(auto modifier : pointedDataProvider->getList(object, "modifiers")){
+		auto type = modifier.getInt("modifier.type");
+
+		if(!(modifier.getInt("modifier.mode") & eModifierMode_Realtime)){
+			continue;
+		}
+
+		if(type == eModifierType_Mirror){
+			mirror(mesh, modifier);
+		} else if(type == eModifierType_Array){
+			array(mesh, modifier);
+		} else {
+			warnings->add("%s skips modifier %s, which cannot be evaluated", objectName.c_str(), modifier.getString("modifier.name").c_str());
+		}
+	}
+}
+
+void PieWriter::append(std::string &result, const char *format, ...){
+	char line[256];
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(line, sizeof(line), format, arguments);
+	va_end(arguments);
+	result += line;
+}
+
+PieWriter::PieWriter(std::string texture, int version){
+	this->texture = texture;
+	this->version = version;
+}
+
+std::string PieWriter::write(ExtractedMesh *mesh){
+	return write(std::vector<ExtractedMesh*>{ mesh });
+}
+
+std::string PieWriter::write(std::vector<ExtractedMesh*> levels, const AnimationTrack *animation){
+	std::string result;
+
+	append(result, "PIE %i\n", version);
+	append(result, "TYPE 10200\n");
+	append(result, "TEXTURE 0 %s 0 0\n", texture.c_str());
+	append(result, "LEVELS %i\n", (int)levels.size());
+
+	for(size_t level = 0; level < levels.size(); level++){
+		auto mesh = levels.at(level);
+
+		append(result, "LEVEL %i\n", (int)level + 1);
+
+		append(result, "POINTS %i\n", mesh->getVertexCount());
+		for(int i = 0; i < mesh->getVertexCount(); i++){
+			auto position = &mesh->positions[i * 3];
+			append(result, "\t%g %g %g\n", position[0], position[1], position[2]);
+		}
+
+		append(result, "POLYGONS %i\n", mesh->getTriangleCount());
+		for(int i = 0; i < mesh->getTriangleCount(); i++){
+			auto loops = &mesh->triangles[i * 3];
+			append(result, "\t200 3 %i %i %i", mesh->loopVertices[loops[0]], mesh->loopVertices[loops[1]], mesh->loopVertices[loops[2]]);
+			for(int j = 0; j < 3; j++){
+				append(result, " %g %g", mesh->uvs[loops[j] * 2], mesh->uvs[loops[j] * 2 + 1]);
+			}
+			append(result, "\n");
+		}
+
+		if(version >= 4 && !mesh->loopNormals.empty()){
+			auto normals = NormalGenerator::pack(mesh);
+
+			append(result, "NORMALS %i\n", mesh->getTriangleCount());
+			for(int i = 0; i < mesh->getTriangleCount(); i++){
+				auto normal = &normals[i * 9];
+				append(result, "\t%g %g %g %g %g %g %g %g %g\n", normal[0], normal[1], normal[2], normal[3], normal[4], normal[5], normal[6], normal[7], normal[8]);
+			}
+		}
+
+		if(animation != nullptr && !animation->frames.empty()){
+			append(result, "ANIMOBJECT %i 0 %i\n", animation->frameTime, (int)animation->frames.size());
+			for(size_t i = 0; i < animation->frames.size(); i++){
+				auto &frame = animation->frames[i];
+				append(result, "\t%i %i %i %i %i %i %i %g %g %g\n", (int)i,
+					(int)lrintf(frame.location[0]), (int)lrintf(frame.location[1]), (int)lrintf(frame.location[2]),
+					(int)lrintf(frame.rotation[0] * 180 / M_PI), (int)lrintf(frame.rotation[1] * 180 / M_PI), (int)lrintf(frame.rotation[2] * 180 / M_PI),
+					frame.scale[0], frame.scale[1], frame.scale[2]);
+			}
+		}
+	}
+
+	return result;
+}
+
+void ObjWriter::append(std::string &result, const char *format, ...){
+	char line[256];
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(line, sizeof(line), format, arguments);
+	va_end(arguments);
+	result += line;
+}
+
+ObjWriter::ObjWriter(std::string texture){
+	this->texture = texture;
+}
+
+std::string ObjWriter::write(ExtractedMesh *mesh, std::string name){
+	std::string result;
+	bool hasNormals = !mesh->loopNormals.empty();
+
+	append(result, "# texture %s\n", texture.c_str());
+	append(result, "o %s\n", name.c_str());
+
+	for(int i = 0; i < mesh->getVertexCount(); i++){
+		auto position = &mesh->positions[i * 3];
+		append(result, "v %g %g %g\n", position[0], position[1], position[2]);
+	}
+
+	// OBJ counts v upwards from the bottom of the texture, PIE downwards from the top
+	for(int i = 0; i < mesh->getLoopCount(); i++){
+		append(result, "vt %g %g\n", mesh->uvs[i * 2], 1 - mesh->uvs[i * 2 + 1]);
+	}
+
+	if(hasNormals){
+		for(int i = 0; i < mesh->getLoopCount(); i++){
+			auto normal = &mesh->loopNormals[i * 3];
+			append(result, "vn %g %g %g\n", normal[0], normal[1], normal[2]);
+		}
+	}
+
+	// Indices are 1-based
+	for(int i = 0; i < mesh->getTriangleCount(); i++){
+		auto loops = &mesh->triangles[i * 3];
+
+		append(result, "f");
+		for(int j = 0; j < 3; j++){
+			if(hasNormals){
+				append(result, " %i/%i/%i", mesh->loopVertices[loops[j]] + 1, loops[j] + 1, loops[j] + 1);
+			} else {
+				append(result, " %i/%i", mesh->loopVertices[loops[j]] + 1, loops[j] + 1);
+			}
+		}
+		append(result, "\n");
+	}
+
+	return result;
+}
+
+void GltfWriter::append(std::string &result, const char *format, ...){
+	char line[512];
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(line, sizeof(line), format, arguments);
+	va_end(arguments);
+	result += line;
+}
+
+void GltfWriter::appendBase64(std::string &result, const std::vector<char> &data){
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t i = 0;
+
+	result.reserve(result.size() + (data.size() + 2) / 3 * 4);
+
+	for(; i + 3 <= data.size(); i += 3){
+		uint32_t bits = (uint8_t)data[i] << 16 | (uint8_t)data[i + 1] << 8 | (uint8_t)data[i + 2];
+		result += alphabet[bits >> 18 & 63];
+		result += alphabet[bits >> 12 & 63];
+		result += alphabet[bits >> 6 & 63];
+		result += alphabet[bits & 63];
+	}
+
+	if(i + 1 == data.size()){
+		uint32_t bits = (uint8_t)data[i] << 16;
+		result += alphabet[bits >> 18 & 63];
+		result += alphabet[bits >> 12 & 63];
+		result += "==";
+	} else if(i + 2 == data.size()){
+		uint32_t bits = (uint8_t)data[i] << 16 | (uint8_t)data[i + 1] << 8;
+		result += alphabet[bits >> 18 & 63];
+		result += alphabet[bits >> 12 & 63];
+		result += alphabet[bits >> 6 & 63];
+		result += '=';
+	}
+}
+
+std::string GltfWriter::escape(const std::string &text){
+	std::string result;
+
+	for(auto c : text){
+		if(c == '"' || c == '\\'){
+			result += '\\';
+		}
+		if((unsigned char)c >= 0x20){
+			result += c;
+		}
+	}
+
+	return result;
+}
+
+GltfWriter::GltfWriter(std::string texture){
+	this->texture = texture;
+}
+
+std::string GltfWriter::write(ExtractedMesh *mesh, std::string name){
+	int loopCount = mesh->getLoopCount();
+	int indexCount = mesh->triangles.size();
+	bool hasNormals = !mesh->loopNormals.empty();
+
+	// Positions, texture coordinates, normals and indices, each 4-byte aligned
+	size_t positionsSize = loopCount * 3 * sizeof(float);
+	size_t uvsSize = loopCount * 2 * sizeof(float);
+	size_t normalsSize = hasNormals ? loopCount * 3 * sizeof(float) : 0;
+	size_t indicesSize = indexCount * sizeof(uint32_t);
+	std::vector<char> buffer(positionsSize + uvsSize + normalsSize + indicesSize);
+
+	float minimum[3] = { 0, 0, 0 };
+	float maximum[3] = { 0, 0, 0 };
+	auto positions = (float*)buffer.data();
+
+	for(int i = 0; i < loopCount; i++){
+		auto position = &mesh->positions[mesh->loopVertices[i] * 3];
+
+		for(int j = 0; j < 3; j++){
+			minimum[j] = i == 0 ? position[j] : std::min(minimum[j], position[j]);
+			maximum[j] = i == 0 ? position[j] : std::max(maximum[j], position[j]);
+		}
+		memcpy(positions + i * 3, position, sizeof(float) * 3);
+	}
+
+	memcpy(buffer.data() + positionsSize, mesh->uvs.data(), uvsSize);
+	if(hasNormals){
+		memcpy(buffer.data() + positionsSize + uvsSize, mesh->loopNormals.data(), normalsSize);
+	}
+
+	auto indices = (uint32_t*)(buffer.data() + positionsSize + uvsSize + normalsSize);
+	for(int i = 0; i < indexCount; i++){
+		indices[i] = mesh->triangles[i];
+	}
+
+	std::string result;
+
+	append(result, "{\n\"asset\":{\"version\":\"2.0\",\"generator\":\"blender-convert\"},\n");
+	append(result, "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\n");
+	append(result, "\"nodes\":[{\"name\":\"%s\",\"mesh\":0}],\n", escape(name).c_str());
+	append(result, "\"meshes\":[{\"name\":\"%s\",\"primitives\":[{\"attributes\":{\"POSITION\":0,\"TEXCOORD_0\":1", escape(name).c_str());
+	if(hasNormals){
+		append(result, ",\"NORMAL\":3");
+	}
+	append(result, "},\"indices\":2,\"material\":0}]}],\n");
+
+	append(result, "\"materials\":[{\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":0},\"metallicFactor\":0}}],\n");
+	append(result, "\"textures\":[{\"source\":0}],\n");
+	append(result, "\"images\":[{\"uri\":\"%s\"}],\n", escape(texture).c_str());
+
+	append(result, "\"accessors\":[\n");
+	append(result, "{\"bufferView\":0,\"componentType\":5126,\"count\":%i,\"type\":\"VEC3\",\"min\":[%g,%g,%g],\"max\":[%g,%g,%g]},\n", loopCount,
+		minimum[0], minimum[1], minimum[2], maximum[0], maximum[1], maximum[2]);
+	append(result, "{\"bufferView\":1,\"componentType\":5126,\"count\":%i,\"type\":\"VEC2\"},\n", loopCount);
+	append(result, "{\"bufferView\":%i,\"componentType\":5125,\"count\":%i,\"type\":\"SCALAR\"}", hasNormals ? 3 : 2, indexCount);
+	if(hasNormals){
+		append(result, ",\n{\"bufferView\":2,\"componentType\":5126,\"count\":%i,\"type\":\"VEC3\"}", loopCount);
+	}
+	append(result, "\n],\n");
+
+	size_t offset = 0;
+	append(result, "\"bufferViews\":[\n");
+	append(result, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34962},\n", offset, positionsSize);
+	offset += positionsSize;
+	append(result, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34962},\n", offset, uvsSize);
+	offset += uvsSize;
+	if(hasNormals){
+		append(result, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34962},\n", offset, normalsSize);
+		offset += normalsSize;
+	}
+	append(result, "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34963}\n", offset, indicesSize);
+	append(result, "],\n");
+
+	append(result, "\"buffers\":[{\"byteLength\":%zu,\"uri\":\"data:application/octet-stream;base64,", buffer.size());
+	appendBase64(result, buffer);
+	append(result, "\"}]\n}\n");
+
+	return result;
+}
+
+bool TextureUnpacker::writeAll(int output, const char *data, size_t size){
+	while(size > 0){
+		auto written = write(output, data, size);
+		if(written <= 0){
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+bool TextureUnpacker::copyAll(int input, off_t offset, int output, size_t size){
+	while(size > 0){
+		auto copied = copy_file_range(input, &offset, output, nullptr, size, 0);
+		if(copied <= 0){
+			return false;
+		}
+		size -= copied;
+	}
+	return true;
+}
+
+bool TextureUnpacker::unpack(const DataPart &packedFile, std::string path){
+	auto pointer = packedFile.getPointer("*data");
+	auto size = packedFile.getInt("size");
+
+	if(pointer == 0 || size <= 0){
+		return false;
+	}
+
+	// Finding the block reads no body; the size check keeps the copy inside it
+	auto block = file->blockProvider->getBlock(pointer);
+	auto offset = pointer - block->memaddr;
+	if(offset + size > block->dataSource->getSize()){
+		char data[100];
+		sprintf(data, "Packed image of %i bytes runs past its block", size);
+		throw std::runtime_error(std::string(data));
+	}
+
+	int output = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(output < 0){
+		throw std::runtime_error(std::string("Could not write ") + path);
+	}
+
+	bool success = false;
+	auto fileOffset = block->dataSource->getFileOffset();
+
+	if(fileOffset >= 0){
+		int input = open(file->path.c_str(), O_RDONLY);
+		if(input >= 0){
+			success = copyAll(input, fileOffset + offset, output, size);
+			close(input);
+		}
+
+		// Kernels or file systems without copy_file_range; start over from block memory
+		if(!success){
+			success = ftruncate(output, 0) == 0 && lseek(output, 0, SEEK_SET) == 0;
+			success = success && writeAll(output, block->dataSource->getData() + offset, size);
+		}
+	} else {
+		success = writeAll(output, block->dataSource->getData() + offset, size);
+	}
+
+	if(close(output) != 0 || !success){
+		throw std::runtime_error(std::string("Could not write ") + path);
+	}
+
+	if(verbose){
+		printf("Unpacked %s (%i bytes)\n", path.c_str(), size);
+	}
+	return true;
+}
+
+TextureUnpacker::TextureUnpacker(BlendFile *file){
+	this->file = file;
+}
+
+bool TextureUnpacker::findPackedFile(PointedDataProvider &pointedDataProvider, const DataPart &image, DataPart &packedFile, std::string &packedPath){
+	// Images keep one packed file before Blender 2.83, and a list of them (one per
+	// view or tile) since
+	if(image.type->hasPath("*packedfile") && image.getPointer("*packedfile") != 0){
+		packedFile = pointedDataProvider.getPointedData(image, "*packedfile");
+		packedPath = "";
+		return true;
+	}
+	if(image.type->hasPath("packedfiles")){
+		for(auto imagePackedFile : pointedDataProvider.getList(image, "packedfiles")){
+			if(imagePackedFile.getPointer("*packedfile") == 0){
+				continue;
+			}
+
+			// the first one is the image the model uses
+			packedFile = pointedDataProvider.getPointedData(imagePackedFile, "*packedfile");
+			packedPath = imagePackedFile.getString("filepath").c_str();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::string TextureUnpacker::getPackedExtension(PointedDataProvider &pointedDataProvider, const DataPart &packedFile, const std::string &packedPath){
+	auto name = getBaseName(packedPath);
+	auto dot = name.find_last_of('.');
+
+	if(dot != std::string::npos && dot > 0 && dot + 1 < name.size()){
+		return name.substr(dot);
+	}
+
+	size_t size;
+	auto data = pointedDataProvider.getPointedBytes(packedFile, "*data", size);
+	auto length = std::min(size, (size_t)std::max(packedFile.getInt("size"), 0));
+
+	if(data != nullptr && length >= 4){
+		if(memcmp(data, "\x89PNG", 4) == 0){
+			return ".png";
+		}
+		if(memcmp(data, "\xff\xd8\xff", 3) == 0){
+			return ".jpg";
+		}
+		if(memcmp(data, "DDS ", 4) == 0){
+			return ".dds";
+		}
+		if(memcmp(data, "BM", 2) == 0){
+			return ".bmp";
+		}
+	}
+
+	return ".png";
+}
+
+std::string TextureUnpacker::getFileName(PointedDataProvider &pointedDataProvider, const DataPart &image){
+	DataPart packedFile;
+	std::string packedPath;
+	bool packed = findPackedFile(pointedDataProvider, image, packedFile, packedPath);
+	auto path = std::string(image.getString("name").c_str());
+	auto name = getBaseName(path.empty() ? packedPath : path);
+
+	if(name.empty() || name == "." || name == ".."){
+		auto extension = packed ? getPackedExtension(pointedDataProvider, packedFile, packedPath) : std::string(".png");
+		name = std::string(image.getString("id.name").c_str() + 2) + extension;
+	}
+
+	return name;
+}
+
+int TextureUnpacker::unpack(std::string directory){
+	BlockCache::Scope scope(file->cache.get());
+	auto &pointedDataProvider = *file->pointedDataProvider;
+	int result = 0;
+
+	for(auto block : file->blockProvider->getBlocks("IM")){
+		auto image = block->getPart();
+		DataPart packedFile;
+		std::string packedPath;
+
+		if(findPackedFile(pointedDataProvider, image, packedFile, packedPath)){
+			result += unpack(packedFile, directory + "/" + getFileName(pointedDataProvider, image));
+		}
+	}
+
+	return result;
+}
+
+int SkylinePacker::fit(size_t index, int rectWidth, int rectHeight){
+	if(skyline[index].x + rectWidth > width){
+		return -1;
+	}
+
+	int y = 0;
+	int remaining = rectWidth;
+	for(size_t i = index; remaining > 0; i++){
+		y = std::max(y, skyline[i].y);
+		if(y + rectHeight > height){
+			return -1;
+		}
+		remaining -= skyline[i].width;
+	}
+
+	return y;
+}
+
+SkylinePacker::SkylinePacker(int width, int height){
+	this->width = width;
+	this->height = height;
+	skyline.push_back(Segment{ 0, 0, width });
+}
+
+bool SkylinePacker::insert(int rectWidth, int rectHeight, int &x, int &y){
+	int bestIndex = -1;
+	int bestBottom = INT_MAX;
+	int bestWidth = INT_MAX;
+
+	for(size_t i = 0; i < skyline.size(); i++){
+		auto top = fit(i, rectWidth, rectHeight);
+
+		if(top >= 0 && (top + rectHeight < bestBottom || (top + rectHeight == bestBottom && skyline[i].width < bestWidth))){
+			bestIndex = i;
+			bestBottom = top + rectHeight;
+			bestWidth = skyline[i].width;
+		}
+	}
+
+	if(bestIndex < 0){
+		return false;
+	}
+
+	x = skyline[bestIndex].x;
+	y = bestBottom - rectHeight;
+	skyline.insert(skyline.begin() + bestIndex, Segment{ x, bestBottom, rectWidth });
+
+	// Segments now under the rectangle shrink or go
+	for(size_t i = bestIndex + 1; i < skyline.size();){
+		auto covered = x + rectWidth - skyline[i].x;
+		if(covered <= 0){
+			break;
+		}
+
+		if(covered < skyline[i].width){
+			skyline[i].x += covered;
+			skyline[i].width -= covered;
+			break;
+		}
+
+		skyline.erase(skyline.begin() + i);
+	}
+
+	for(size_t i = 0; i + 1 < skyline.size();){
+		if(skyline[i].y == skyline[i + 1].y){
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		} else {
+			i++;
+		}
+	}
+
+	return true;
+}
+
+bool TextureAtlas::IslandRect::overlaps(const IslandRect &other) const {
+	return x0 < other.x1 && other.x0 < x1 && y0 < other.y1 && other.y0 < y1;
+}
+
+void TextureAtlas::IslandRect::add(const IslandRect &other){
+	x0 = std::min(x0, other.x0);
+	y0 = std::min(y0, other.y0);
+	x1 = std::max(x1, other.x1);
+	y1 = std::max(y1, other.y1);
+}
+
+int TextureAtlas::findRoot(std::vector<int> &parents, int i){
+	while(parents[i] != i){
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+int TextureAtlas::findIslands(ExtractedMesh *mesh, std::vector<int> &loopIslands){
+	auto loopCount = mesh->getLoopCount();
+	std::vector<int> loopPolys(loopCount);
+	std::vector<int> parents(mesh->getPolyCount());
+
+	for(int poly = 0; poly < mesh->getPolyCount(); poly++){
+		parents[poly] = poly;
+		for(int i = 0; i < mesh->polyLoopCounts[poly]; i++){
+			loopPolys[mesh->polyLoopStarts[poly] + i] = poly;
+		}
+	}
+
+	// Sorting loops by vertex and coordinates puts the corners to join next to each other
+	std::vector<int> order(loopCount);
+	for(int i = 0; i < loopCount; i++){
+		order[i] = i;
+	}
+
+	auto &vertices = mesh->loopVertices;
+	auto &uvs = mesh->uvs;
+	auto less = [&](int a, int b){
+		if(vertices[a] != vertices[b]){
+			return vertices[a] < vertices[b];
+		}
+		if(uvs[a * 2] != uvs[b * 2]){
+			return uvs[a * 2] < uvs[b * 2];
+		}
+		return uvs[a * 2 + 1] < uvs[b * 2 + 1];
+	};
+	std::sort(order.begin(), order.end(), less);
+
+	for(int i = 1; i < loopCount; i++){
+		if(!less(order[i - 1], order[i])){
+			parents[findRoot(parents, loopPolys[order[i - 1]])] = findRoot(parents, loopPolys[order[i]]);
+		}
+	}
+
+	std::vector<int> polyIslands(parents.size(), -1);
+	int islandCount = 0;
+	loopIslands.resize(loopCount);
+
+	for(int i = 0; i < loopCount; i++){
+		auto &island = polyIslands[findRoot(parents, loopPolys[i])];
+		if(island < 0){
+			island = islandCount++;
+		}
+		loopIslands[i] = island;
+	}
+
+	return islandCount;
+}
+
+std::vector<TextureAtlas::IslandRect> TextureAtlas::findRects(ExtractedMesh *mesh, const AtlasImage &image, std::vector<int> &loopRects){
+	std::vector<int> loopIslands;
+	auto islandCount = findIslands(mesh, loopIslands);
+	std::vector<IslandRect> rects(islandCount);
+
+	for(int i = 0; i < mesh->getLoopCount(); i++){
+		auto &rect = rects[loopIslands[i]];
+		auto u = mesh->uvs[i * 2] * image.width;
+		auto v = mesh->uvs[i * 2 + 1] * image.height;
+
+		rect.x0 = std::min(rect.x0, (int)floorf(u) - padding);
+		rect.y0 = std::min(rect.y0, (int)floorf(v) - padding);
+		rect.x1 = std::max(rect.x1, (int)ceilf(u) + padding);
+		rect.y1 = std::max(rect.y1, (int)ceilf(v) + padding);
+	}
+
+	std::vector<int> parents(islandCount);
+	for(int i = 0; i < islandCount; i++){
+		parents[i] = i;
+	}
+
+	// Merging grows rectangles, which can make them overlap others; repeat until stable
+	bool merged = true;
+	while(merged){
+		merged = false;
+		for(int i = 0; i < islandCount; i++){
+			if(parents[i] != i){
+				continue;
+			}
+			for(int j = i + 1; j < islandCount; j++){
+				if(parents[j] == j && rects[i].overlaps(rects[j])){
+					rects[i].add(rects[j]);
+					parents[j] = i;
+					merged = true;
+				}
+			}
+		}
+	}
+
+	std::vector<int> islandRects(islandCount);
+	std::vector<IslandRect> result;
+	for(int i = 0; i < islandCount; i++){
+		if(parents[i] == i){
+			islandRects[i] = result.size();
+			result.push_back(rects[i]);
+		}
+	}
+	for(int i = 0; i < islandCount; i++){
+		islandRects[i] = islandRects[findRoot(parents, i)];
+	}
+
+	loopRects.resize(mesh->getLoopCount());
+	for(int i = 0; i < mesh->getLoopCount(); i++){
+		loopRects[i] = islandRects[loopIslands[i]];
+	}
+
+	return result;
+}
+
+bool TextureAtlas::place(int page, const std::string &image, const std::vector<IslandRect> &rects, std::vector<int> &rectRegions){
+	auto packer = packers[page];
+	std::vector<AtlasRegion> added;
+	rectRegions.assign(rects.size(), -1);
+
+	// Tall rectangles first leave a flatter skyline
+	std::vector<int> order(rects.size());
+	for(size_t i = 0; i < rects.size(); i++){
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b){
+		return rects[a].y1 - rects[a].y0 > rects[b].y1 - rects[b].y0;
+	});
+
+	for(auto i : order){
+		auto &rect = rects[i];
+		AtlasRegion region{ image, rect.x0, rect.y0, rect.x1 - rect.x0, rect.y1 - rect.y0, page, 0, 0 };
+
+		for(size_t j = 0; j < regions.size() && rectRegions[i] < 0; j++){
+			auto &other = regions[j];
+			if(other.page == page && other.image == image && other.sourceX == region.sourceX && other.sourceY == region.sourceY && other.width == region.width && other.height == region.height){
+				rectRegions[i] = j;
+			}
+		}
+		if(rectRegions[i] >= 0){
+			continue;
+		}
+
+		if(!packer.insert(region.width, region.height, region.x, region.y)){
+			return false;
+		}
+
+		rectRegions[i] = regions.size() + added.size();
+		added.push_back(region);
+	}
+
+	packers[page] = packer;
+	regions.insert(regions.end(), added.begin(), added.end());
+	return true;
+}
+
+TextureAtlas::TextureAtlas(std::string name, int pageSize, WarningLog *warnings, int padding){
+	this->name = name;
+	this->pageSize = pageSize;
+	this->warnings = warnings;
+	this->padding = padding;
+}
+
+int TextureAtlas::getPageCount(){
+	return packers.size();
+}
+
+std::string TextureAtlas::getPageName(int page){
+	return name + "-" + std::to_string(page) + ".png";
+}
+
+bool TextureAtlas::readPngSize(const char *data, size_t size, int &width, int &height){
+	auto bytes = (const unsigned char*)data;
+
+	if(size < 24 || memcmp(data, "\x89PNG\r\n\x1a\n", 8) != 0 || memcmp(data + 12, "IHDR", 4) != 0){
+		return false;
+	}
+
+	width = bytes[16] << 24 | bytes[17] << 16 | bytes[18] << 8 | bytes[19];
+	height = bytes[20] << 24 | bytes[21] << 16 | bytes[22] << 8 | bytes[23];
+	return width > 0 && height > 0;
+}
+
+AtlasImage TextureAtlas::findImage(BlendFile &file, const DataPart &mesh){
+	enum { IMA_SRC_FILE = 1, IMA_SRC_GENERATED = 4 };
+	auto &pointedDataProvider = *file.pointedDataProvider;
+	AtlasImage result;
+	size_t size;
+
+	auto materials = pointedDataProvider.getPointedBytes(mesh, "**mat", size);
+	auto pointerSize = file.typeProvider->pointerSize;
+	if(materials == nullptr || mesh.getShort("totcol") < 1 || size < (size_t)pointerSize){
+		return result;
+	}
+
+	auto materialBlock = file.blockProvider->findBlock(readPointer(materials, pointerSize));
+	if(materialBlock == nullptr){
+		return result;
+	}
+
+	auto material = materialBlock->getPart();
+	unsigned long long imagePointer = 0;
+
+	if(material.type->hasPath("*nodetree") && material.getPointer("*nodetree") != 0){
+		auto nodeTree = pointedDataProvider.getPointedData(material, "*nodetree");
+
+		for(auto node : pointedDataProvider.getList(nodeTree, "nodes")){
+			if(strcmp(node.getString("idname").c_str(), "ShaderNodeTexImage") == 0 && node.getPointer("*id") != 0){
+				imagePointer = node.getPointer("*id");
+				break;
+			}
+		}
+	} else if(material.type->hasPath("*mtex") && material.getPointer("*mtex") != 0){
+		auto textureSlot = pointedDataProvider.getPointedData(material, "*mtex");
+
+		if(textureSlot.getPointer("*tex") != 0){
+			imagePointer = pointedDataProvider.getPointedData(textureSlot, "*tex").getPointer("*ima");
+		}
+	}
+
+	auto imageBlock = imagePointer != 0 ? file.blockProvider->findBlock(imagePointer) : nullptr;
+	if(imageBlock == nullptr){
+		return result;
+	}
+
+	auto image = imageBlock->getPart();
+	auto path = std::string(image.getString("name").c_str());
+	result.name = TextureUnpacker::getFileName(pointedDataProvider, image);
+
+	if(image.getShort("source") == IMA_SRC_GENERATED){
+		result.width = image.getInt("gen_x");
+		result.height = image.getInt("gen_y");
+		return result;
+	}
+	if(image.getShort("source") != IMA_SRC_FILE){
+		return result;
+	}
+
+	DataPart packedFile;
+	std::string packedPath;
+	if(TextureUnpacker::findPackedFile(pointedDataProvider, image, packedFile, packedPath)){
+		auto data = pointedDataProvider.getPointedBytes(packedFile, "*data", size);
+
+		if(data != nullptr){
+			readPngSize(data, std::min(size, (size_t)packedFile.getInt("size")), result.width, result.height);
+		}
+		return result;
+	}
+
+	if(path.compare(0, 2, "//") == 0){
+		auto slash = file.path.find_last_of('/');
+		path = (slash == std::string::npos ? std::string(".") : file.path.substr(0, slash)) + "/" + path.substr(2);
+	}
+
+	char header[24];
+	int input = open(path.c_str(), O_RDONLY);
+	if(input >= 0){
+		if(read(input, header, sizeof(header)) == sizeof(header)){
+			readPngSize(header, sizeof(header), result.width, result.height);
+		}
+		close(input);
+	}
+
+	return result;
+}
+
+void TextureAtlas::pack(std::vector<ExtractedMesh*> &meshes, std::vector<AtlasImage> &images){
+	std::vector<std::vector<IslandRect>> meshRects(meshes.size());
+	std::vector<std::vector<int>> loopRects(meshes.size());
+	std::vector<long long> areas(meshes.size());
+
+	parallelFor(meshes.size(), 1, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			if(images[i].width > 0 && images[i].height > 0 && !meshes[i]->uvs.empty()){
+				meshRects[i] = findRects(meshes[i], images[i], loopRects[i]);
+			}
+			for(auto &rect : meshRects[i]){
+				areas[i] += (long long)(rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+			}
+		}
+	});
+
+	// Largest meshes first, each on the first page it fits
+	std::vector<int> order(meshes.size());
+	for(size_t i = 0; i < meshes.size(); i++){
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b){
+		return areas[a] > areas[b];
+	});
+
+	meshPages.assign(meshes.size(), -1);
+	std::vector<std::vector<int>> rectRegions(meshes.size());
+
+	for(auto i : order){
+		if(meshRects[i].empty()){
+			if(!images[i].name.empty()){
+				warnings->add("%s: size of %s unknown, not added to the atlas", meshes[i]->name.c_str() + 2, images[i].name.c_str());
+			}
+			continue;
+		}
+
+		for(int page = 0; meshPages[i] < 0; page++){
+			bool fresh = page == getPageCount();
+			if(fresh){
+				packers.push_back(SkylinePacker(pageSize, pageSize));
+			}
+
+			if(place(page, images[i].name, meshRects[i], rectRegions[i])){
+				meshPages[i] = page;
+			} else if(fresh){
+				packers.pop_back();
+				warnings->add("%s: islands do not fit a %ix%i page, not added to the atlas", meshes[i]->name.c_str() + 2, pageSize, pageSize);
+				break;
+			}
+		}
+	}
+
+	// u' = (u * width - sourceX + x) / pageSize, and the same for v, per loop
+	parallelFor(meshes.size(), 1, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			if(meshPages[i] < 0){
+				continue;
+			}
+
+			auto mesh = meshes[i];
+			std::vector<float> transforms; // u scale, v scale, u offset, v offset per rect
+			for(auto region : rectRegions[i]){
+				auto &target = regions[region];
+				transforms.push_back((float)images[i].width / pageSize);
+				transforms.push_back((float)images[i].height / pageSize);
+				transforms.push_back((float)(target.x - target.sourceX) / pageSize);
+				transforms.push_back((float)(target.y - target.sourceY) / pageSize);
+			}
+
+			for(int loop = 0; loop < mesh->getLoopCount(); loop++){
+				auto transform = &transforms[loopRects[i][loop] * 4];
+				auto uv = &mesh->uvs[loop * 2];
+				uv[0] = uv[0] * transform[0] + transform[2];
+				uv[1] = uv[1] * transform[1] + transform[3];
+			}
+		}
+	});
+}
+
+std::string TextureAtlas::writeManifest(std::vector<AtlasImage> &images){
+	std::string result = "{\n\t\"pages\": [\n";
+
+	for(int page = 0; page < getPageCount(); page++){
+		result += "\t\t{ \"file\": \"" + getPageName(page) + "\", \"width\": " + std::to_string(pageSize) + ", \"height\": " + std::to_string(pageSize) + ", \"regions\": [\n";
+
+		bool first = true;
+		for(auto &region : regions){
+			if(region.page != page){
+				continue;
+			}
+
+			int imageWidth = 0;
+			int imageHeight = 0;
+			for(auto &image : images){
+				if(image.name == region.image){
+					imageWidth = image.width;
+					imageHeight = image.height;
+				}
+			}
+			// Padding past the image edge repeats the edge texels; only islands wrap
+			bool wraps = region.sourceX + padding < 0 || region.sourceY + padding < 0 || region.sourceX + region.width - padding > imageWidth || region.sourceY + region.height - padding > imageHeight;
+
+			char line[1024];
+			snprintf(line, sizeof(line), "%s\t\t\t{ \"image\": \"%s\", \"source\": [%i, %i, %i, %i], \"target\": [%i, %i], \"wrap\": %s }", first ? "" : ",\n",
+				region.image.c_str(), region.sourceX, region.sourceY, region.width, region.height, region.x, region.y, wraps ? "true" : "false");
+			result += line;
+			first = false;
+		}
+
+		result += std::string(first ? "" : "\n") + "\t\t] }" + (page + 1 < getPageCount() ? "," : "") + "\n";
+	}
+
+	return result + "\t]\n}\n";
+}
+
+std::vector<ExtractedMesh*> ExtractedModel::getLevels(){
+	std::vector<ExtractedMesh*> result;
+	for(auto &level : levels){
+		result.push_back(&*level);
+	}
+	return result;
+}
+
+ConvertedModel::ConvertedModel(std::string name){
+	this->name = name;
+}
+
+bool readFile(std::string path, std::string &contents){
+	MemoryScope scope(MEMORY_FILE);
+	std::ifstream is(path, std::ifstream::binary);
+
+	if(!is){
+		return false;
+	}
+
+	is.seekg(0, std::ios::end);
+	contents.resize((size_t)is.tellg());
+	is.seekg(0, std::ios::beg);
+	is.read(&contents[0], contents.size());
+
+	if(!is){
+		contents.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool writeFile(std::string path, const std::string &contents){
+	std::ofstream os(path, std::ofstream::binary);
+	os.write(contents.data(), contents.size());
+	return (bool)os;
+}
+
+bool blockAddressComparer (const DataBlock *a, const DataBlock *b) {
+	return a->memaddr < b->memaddr;
+}
+
+int parallelPrefixSum(std::vector<int> &values){
+	std::vector<int> chunkSums(std::thread::hardware_concurrency() + 1, 0);
+	size_t minChunkSize = 1 << 14;
+
+	parallelForChunks(values.size(), minChunkSize, [&values, &chunkSums](size_t begin, size_t end, size_t chunk){
+		int sum = 0;
+		for(size_t i = begin; i < end; i++){
+			sum += values[i];
+		}
+		chunkSums[chunk] = sum;
+	});
+
+	int total = 0;
+	for(auto &sum : chunkSums){
+		auto chunkStart = total;
+		total += sum;
+		sum = chunkStart;
+	}
+
+	parallelForChunks(values.size(), minChunkSize, [&values, &chunkSums](size_t begin, size_t end, size_t chunk){
+		int offset = chunkSums[chunk];
+		for(size_t i = begin; i < end; i++){
+			auto value = values[i];
+			values[i] = offset;
+			offset += value;
+		}
+	});
+
+	return total;
+}
+
+std::string getBaseName(std::string path){
+	auto slash = path.find_last_of("/\\");
+
+	if(slash != std::string::npos){
+		path = path.substr(slash + 1);
+	}
+
+	return path;
+}
+
+std::string findTextureName(BlendFile &file){
+	BlockCache::Scope scope(file.cache.get());
+
+	// Render results and unsaved generated images have neither a path nor packed data
+	for(auto block : file.blockProvider->getBlocks("IM")){
+		auto image = block->getPart();
+		DataPart packedFile;
+		std::string packedPath;
+
+		if(!std::string(image.getString("name").c_str()).empty() || TextureUnpacker::findPackedFile(*file.pointedDataProvider, image, packedFile, packedPath)){
+			return TextureUnpacker::getFileName(*file.pointedDataProvider, image);
+		}
+	}
+
+	return "page-0.png"; // no image file in the file
+}
+
+DataBlock* findMeshObject(BlendFile &file, unsigned long long meshAddress){
+	for(auto object : file.blockProvider->getBlocks("OB")){
+		if(object->getPart().getPointer("*data") == meshAddress){
+			return object;
+		}
+	}
+
+	return nullptr;
+}
+
+// Frame range and scale of the file's scene, shared by all of its meshes
+struct SceneSettings {
+	int frameStart;
+	int frameEnd;
+	float framesPerSecond = 24;
+	float shapeFrame; // shape keys are applied at the first frame exported, or the scene's current frame
+	float unitScale = 1;
+};
+
+static SceneSettings readSceneSettings(BlendFile &file, ConvertOptions &options){
+	SceneSettings settings;
+	settings.frameStart = options.frameStart;
+	settings.frameEnd = options.frameEnd;
+	settings.shapeFrame = options.frameStart;
+
+	auto scenes = file.blockProvider->getBlocks("SC", 1);
+	if(!scenes.empty()){
+		auto scene = scenes[0]->getPart();
+
+		if(settings.frameEnd < settings.frameStart){
+			settings.frameStart = scene.getInt("r.sfra");
+			settings.frameEnd = scene.getInt("r.efra");
+		}
+		settings.framesPerSecond = scene.getShort("r.frs_sec") / scene.getFloat("r.frs_sec_base");
+		settings.shapeFrame = options.animate ? settings.frameStart : scene.getInt("r.cfra");
+		settings.unitScale = scene.getFloat("unit.scale_length");
+	}
+
+	return settings;
+}
+
+// Extracts the mesh of source with its shape keys, modifiers and transform applied, and
+// triangulated. Its animation and bounds go to model; its image to image, with an atlas.
+static std::unique_ptr<ExtractedMesh> extractMesh(BlendFile &file, LinkedId &source, unsigned long long meshAddress, const SceneSettings &scene, ConvertOptions &options, ExtractedModel &model, AtlasImage &image){
+	BlockCache::Scope scope(source.file->cache.get());
+	auto part = source.block->getPart();
+	auto mesh = MeshExtractor(&*source.file->pointedDataProvider).extract(part);
+
+	if(options.atlasSize){
+		image = TextureAtlas::findImage(*source.file, part);
+	}
+
+	ShapeKeyEvaluator shapeKeys(&*source.file->pointedDataProvider, part);
+	if(shapeKeys.hasKeys()){
+		auto positions = shapeKeys.evaluate(scene.shapeFrame);
+
+		if(positions.size() == mesh->positions.size()){
+			mesh->positions = std::move(positions);
+		}
+	}
+
+	if(options.modifiers || options.animate || options.transform){
+		BlockCache::Scope mainScope(file.cache.get());
+		auto object = findMeshObject(file, meshAddress);
+		bool animated = false;
+
+		if(object != nullptr && options.modifiers){
+			ModifierEvaluator(&*file.pointedDataProvider, object->getPart(), options.warnings).evaluate(&*mesh);
+		}
+
+		if(object != nullptr && options.animate){
+			ObjectAnimator animator(&*file.pointedDataProvider, object->getPart());
+
+			if(animator.isAnimated()){
+				model.animation = animator.evaluate(scene.frameStart, scene.frameEnd, scene.framesPerSecond);
+				animated = true;
+
+				// PIE frames hold whole numbers, so locations are rounded in game units
+				if(options.transform){
+					model.animation.transform(scene.unitScale * options.transformScale);
+				}
+			}
+		}
+
+		// Animated objects keep their transform in the animation instead
+		if(options.transform){
+			float objectMatrix[16];
+			bool hasMatrix = object != nullptr && !animated;
+
+			if(hasMatrix){
+				auto objectPart = object->getPart();
+				for(int j = 0; j < 16; j++){
+					objectMatrix[j] = objectPart.getFloat("obmat", j);
+				}
+			}
+
+			PositionTransformer transformer(hasMatrix ? objectMatrix : nullptr, scene.unitScale * options.transformScale, options.quantizeStep);
+			model.bounds = transformer.transform(&*mesh);
+		}
+	}
+
+	Triangulator::triangulate(&*mesh);
+	if(options.normals){
+		NormalGenerator::generate(&*mesh);
+	}
+
+	return mesh;
+}
+
+// Completes model from its extracted mesh and the levels simplified from it
+static void finishModel(ExtractedModel &model, std::unique_ptr<ExtractedMesh> mesh, std::vector<std::unique_ptr<ExtractedMesh>> &lods, ConvertOptions &options){
+	// Simplified levels get normals from their own geometry
+	if(options.normals){
+		for(auto &lod : lods){
+			NormalGenerator::generate(&*lod);
+		}
+	}
+
+	// Blender prefixes ID names with their two letter code
+	model.name = mesh->name.substr(2);
+	model.levels.push_back(std::move(mesh));
+	for(auto &lod : lods){
+		model.levels.push_back(std::move(lod));
+	}
+
+	if(options.optimizeVertexCache){
+		for(size_t level = 0; level < model.levels.size(); level++){
+			auto before = VertexCacheOptimizer::getACMR(&*model.levels[level]);
+			VertexCacheOptimizer::optimize(&*model.levels[level]);
+			auto after = VertexCacheOptimizer::getACMR(&*model.levels[level]);
+
+			if(options.verbose){
+				printf("%s level %i: ACMR %0.3f -> %0.3f\n", model.name.c_str(), (int)level + 1, before, after);
+			}
+		}
+	}
+
+	if(options.transform && options.verbose){
+		auto &box = model.bounds;
+		printf("%s: bounds %g %g %g to %g %g %g, radius %g\n", model.name.c_str(), box.minimum[0], box.minimum[1], box.minimum[2], box.maximum[0], box.maximum[1], box.maximum[2], box.radius);
+	}
+}
+
+void extractModels(BlendFile &file, ConvertOptions &options, const ModelVisitor &visit, std::string *atlasManifest){
+	MemoryScope scope(MEMORY_MESHES);
+	std::vector<LinkedId> sources;
+	std::vector<unsigned long long> meshAddresses; // as referenced by objects in file
+
+	for(auto block : file.blockProvider->getBlocks("ME")){
+		sources.push_back(LinkedId(nullptr, &file, block));
+		meshAddresses.push_back(block->memaddr);
+	}
+
+	LibraryLinker linker(&file, &BlendFileCache::getShared());
+
+	for(auto placeholder : linker.getLinkedIds("ME")){
+		sources.push_back(linker.resolve(placeholder));
+		meshAddresses.push_back(placeholder->memaddr);
+	}
+
+	auto scene = readSceneSettings(file, options);
+	auto texture = findTextureName(file);
+
+	// Streamed meshes go through extraction, simplification and visit one at a time, so
+	// only a single mesh with its levels is held while its blocks are read. An atlas
+	// needs the texture coordinates of every mesh before it can place any of them.
+	if(file.cache && !options.atlasSize){
+		for(size_t i = 0; i < sources.size(); i++){
+			ExtractedModel model;
+			AtlasImage image;
+			auto mesh = extractMesh(file, sources[i], meshAddresses[i], scene, options, model, image);
+			auto lods = LodGenerator::generate({ &*mesh }, options.lodTriangleCounts);
+
+			model.texture = texture;
+			finishModel(model, std::move(mesh), lods[0], options);
+			visit(model, i, sources.size());
+		}
+
+		return;
+	}
+
+	std::vector<ExtractedModel> models(sources.size());
+	std::vector<std::unique_ptr<ExtractedMesh>> meshes(sources.size());
+	std::vector<ExtractedMesh*> meshPointers;
+	std::vector<AtlasImage> images(sources.size());
+	std::vector<std::exception_ptr> errors(sources.size());
+
+	// Meshes are extracted in parallel, reading the files through their finalized,
+	// read-only providers. A streamed file with an atlas is read one mesh at a time, so
+	// the blocks of each mesh can be evicted again before the next one is read.
+	parallelFor(sources.size(), file.cache ? sources.size() : 1, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			try {
+				meshes[i] = extractMesh(file, sources[i], meshAddresses[i], scene, options, models[i], images[i]);
+			} catch(...) {
+				errors[i] = std::current_exception();
+			}
+		}
+	});
+
+	for(size_t i = 0; i < sources.size(); i++){
+		if(errors[i]){
+			std::rethrow_exception(errors[i]);
+		}
+		meshPointers.push_back(&*meshes[i]);
+		models[i].texture = texture;
+	}
+
+	// Packed before simplifying, so simplified levels inherit the atlas coordinates
+	if(options.atlasSize){
+		TextureAtlas atlas(options.atlasName, options.atlasSize, options.warnings);
+		atlas.pack(meshPointers, images);
+
+		for(size_t i = 0; i < meshes.size(); i++){
+			if(atlas.meshPages[i] >= 0){
+				models[i].texture = atlas.getPageName(atlas.meshPages[i]);
+			} else if(!images[i].name.empty()){
+				models[i].texture = images[i].name;
+			}
+		}
+
+		if(options.verbose){
+			printf("Atlas: %i regions on %i pages of %ix%i\n", (int)atlas.regions.size(), atlas.getPageCount(), options.atlasSize, options.atlasSize);
+		}
+		if(atlasManifest != nullptr){
+			*atlasManifest = atlas.writeManifest(images);
+		}
+	}
+
+	auto lods = LodGenerator::generate(meshPointers, options.lodTriangleCounts);
+
+	for(size_t i = 0; i < models.size(); i++){
+		finishModel(models[i], std::move(meshes[i]), lods[i], options);
+		visit(models[i], i, models.size());
+		models[i] = ExtractedModel();
+	}
+}
+
+std::vector<ExtractedModel> extractModels(BlendFile &file, ConvertOptions &options, std::string *atlasManifest){
+	std::vector<ExtractedModel> result;
+
+	extractModels(file, options, [&result](ExtractedModel &model, size_t, size_t){
+		result.push_back(std::move(model));
+	}, atlasManifest);
+
+	return result;
+}
+
+std::string formatModel(ExtractedModel &model, const std::string &format, ConvertOptions &options){
+	if(format == "pie"){
+		return PieWriter(model.texture, options.normals ? 4 : 3).write(model.getLevels(), &model.animation);
+	}
+	if(format == "obj"){
+		return ObjWriter(model.texture).write(&*model.levels[0], model.name);
+	}
+	if(format == "gltf"){
+		return GltfWriter(model.texture).write(&*model.levels[0], model.name);
+	}
+
+	throw std::runtime_error(std::string("Unknown output format: ") + format);
+}
+
+std::vector<ConvertedModel> convertModels(BlendFile &file, ConvertOptions &options, std::string *atlasManifest){
+	auto models = extractModels(file, options, atlasManifest);
+	std::vector<ConvertedModel> result;
+
+	for(auto &model : models){
+		result.push_back(ConvertedModel(model.name));
+		result.back().bounds = model.bounds;
+		for(auto &format : options.formats){
+			result.back().outputs[format] = std::string();
+		}
+	}
+
+	// Every output of every model is written concurrently from the same extracted
+	// meshes; the writers only read them
+	size_t formatCount = options.formats.size();
+	MemoryScope scope(MEMORY_OUTPUT);
+
+	parallelFor(models.size() * formatCount, 1, [&](size_t begin, size_t end){
+		for(size_t job = begin; job < end; job++){
+			auto i = job / formatCount;
+			auto &format = options.formats[job % formatCount];
+
+			result[i].outputs.at(format) = formatModel(models[i], format, options);
+		}
+	});
+
+	return result;
+}
+
+bool writeModel(std::string path, ConvertedModel &model, bool appendName){
+	auto extension = path.find_last_of('.');
+	auto stem = extension == std::string::npos ? path : path.substr(0, extension);
+	auto suffix = extension == std::string::npos ? std::string("") : path.substr(extension);
+	bool success = true;
+
+	for(auto &output : model.outputs){
+		auto outputSuffix = output.first == "pie" ? suffix : "." + output.first;
+		auto modelPath = appendName ? stem + "-" + model.name + outputSuffix : stem + outputSuffix;
+
+		if(!writeFile(modelPath, output.second)){
+			printf("Error: Could not write %s\n", modelPath.c_str());
+			success = false;
+		}
+	}
+
+	return success;
+}
+
+bool writeModels(std::string path, std::vector<ConvertedModel> &models){
+	bool success = true;
+
+	for(auto &model : models){
+		success = writeModel(path, model, models.size() != 1) && success;
+	}
+
+	return success;
+}
+
+bool convertAndWriteModels(BlendFile &file, ConvertOptions &options, std::string path, std::string *atlasManifest){
+	bool success = true;
+
+	extractModels(file, options, [&](ExtractedModel &model, size_t, size_t count){
+		MemoryScope scope(MEMORY_OUTPUT);
+		ConvertedModel converted(model.name);
+		converted.bounds = model.bounds;
+
+		for(auto &format : options.formats){
+			converted.outputs[format] = formatModel(model, format, options);
+		}
+
+		success = writeModel(path, converted, count != 1) && success;
+	}, atlasManifest);
+
+	return success;
+}
@@ -0,0 +1,1389 @@
+#pragma once
+
+// The reader and converter shared by blender-convert and libblendconvert. These classes
+// are internal; programs embedding the library use the C API in blendconvert.h.
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <fstream>
+#include <kaitai/kaitaistream.h>
+#include "blender_blend.h"
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <limits.h>
+#include <stdlib.h>
+#include <queue>
+#include <set>
+#include <list>
+#include <unordered_map>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// References:
+//   https://formats.kaitai.io/blender_blend/index.html
+//   http://homac.cakelab.org/projects/JavaBlend/spec.html
+//   https://developer.blender.org/diffusion/B/browse/master/doc/blender_file_format/BlendFileReader.py
+//   https://fossies.org/linux/blender/doc/blender_file_format/mystery_of_the_blend.html
+//   https://archive.blender.org/wiki/index.php/Dev:Source/Architecture/File_Format/#Structure_DNA
+//   https://wiki.blender.org/wiki/Source/Architecture/RNA
+
+// Pointers are stored in the file's (little endian) byte order
+unsigned long long readPointer(const char* data, int pointerSize);
+
+// Parts of the converter that heap memory is attributed to
+enum MemorySubsystem {
+	MEMORY_OTHER,
+	MEMORY_FILE, // whole file contents
+	MEMORY_PARSE_TREE, // kaitai objects, including their raw block bodies
+	MEMORY_BLOCK_BODIES, // DataSource copies and streamed bodies
+	MEMORY_SCHEMA, // DNA and TypeProvider types
+	MEMORY_POINTERS, // address tables for pointer resolution
+	MEMORY_MESHES, // extracted meshes and their levels
+	MEMORY_OUTPUT, // written models and dumps
+	MEMORY_SUBSYSTEM_COUNT
+};
+
+// Live and peak heap bytes per subsystem. Allocations are attributed to the subsystem
+// of the MemoryScope that is open on the allocating thread. Counting needs a program
+// built with TRACK_MEMORY defined, whose global operator new and delete report here;
+// the library itself is the same either way. Other programs only report the peak
+// resident size of the process.
+class MemoryTracker {
+	private:
+	static std::atomic<bool> tracking; // set by the first reported allocation
+	static std::atomic<long long> live[MEMORY_SUBSYSTEM_COUNT];
+	static std::atomic<long long> peak[MEMORY_SUBSYSTEM_COUNT];
+	static std::atomic<long long> totalLive;
+	static std::atomic<long long> totalPeak;
+	static std::atomic<long long> inputBytes;
+
+	static void raisePeak(std::atomic<long long> &peak, long long value);
+
+	public:
+	static thread_local int current;
+
+	// Sits in front of every tracked allocation, keeping the returned memory aligned
+	struct alignas(16) Header {
+		size_t size;
+		int subsystem;
+	};
+
+	static bool isTracking();
+	static void allocated(int subsystem, size_t size);
+	static void freed(int subsystem, size_t size);
+
+	// Input files read or streamed, for the peak per input MB
+	static void addInput(size_t size);
+
+	// The tracked peak, or the peak resident size when allocations are not tracked
+	static long long getPeak();
+
+	// Peak bytes per byte of input, or 0 before any input was read
+	static double getPeakPerInput();
+
+	static void printReport();
+};
+
+// Attributes the allocations of this thread to subsystem until the scope closes
+class MemoryScope {
+	private:
+	int previous;
+
+	public:
+	MemoryScope(MemorySubsystem subsystem);
+	~MemoryScope();
+};
+
+// Receives the warnings of conversions. The shared log prints them as they come; a log
+// that does not print keeps them to be read back, as the C API does.
+class WarningLog {
+	private:
+	std::mutex mutex;
+	std::vector<std::string> messages;
+
+	public:
+	bool print;
+	WarningLog(bool print);
+	static WarningLog& getShared();
+	void add(const char *format, ...);
+
+	// Returns the kept messages and clears them
+	std::vector<std::string> take();
+};
+
+
+bool readFile(std::string path, std::string &contents);
+
+bool writeFile(std::string path, const std::string &contents);
+
+class BlendField{
+	public:
+	std::string name;
+	std::string type;
+	int size;
+	int offset;
+	int arraySize = -1;
+	std::vector<int> dimensions;
+	BlendField(std::string name, std::string type, int size, int offset, int arraySize, std::vector<int> dimensions);
+};
+
+// A field anywhere inside a struct, nested structs flattened into a dotted path such as
+// "id.name". The offset is from the start of the outermost struct with every index at
+// zero; each array dimension met along the path has a stride to step through it.
+class BlendPath {
+	public:
+	std::string type;
+	int offset;
+	int elementSize;
+	int length;
+	std::vector<int> dimensions;
+	std::vector<int> strides;
+};
+
+class BlendLocation {
+	public:
+	BlendPath *path;
+	int offset;
+	int length; // bytes from offset to the end of the addressed element or subarray
+};
+
+class BlendType {
+	private:
+	std::vector<std::unique_ptr<BlendField>> fields;
+	std::map<std::string, BlendField*> fieldsByName;
+	std::map<std::string, std::unique_ptr<BlendPath>> paths;
+
+	public:
+	std::string name;
+	int size;
+	BlendType(std::string name, int size, std::vector<BlendField*> fields);
+	std::vector<BlendField*> getFields();
+	BlendField* getField(std::string name);
+	void addPath(std::string name, BlendPath *path);
+	std::vector<std::string> getPathNames();
+
+	// Resolves a path like "id.name" or "obmat[3][2]". Trailing indexes may be left out,
+	// addressing the whole subarray.
+	BlendLocation locate(std::string path);
+
+	int getOffset(std::string path);
+
+	// Whether a field exists, for fields that were added or dropped between Blender versions
+	bool hasPath(std::string path);
+};
+
+// Describes the struct types of a file from its DNA1 block. Types are compiled lazily
+// until finalize() is called; from then on nothing is modified, and every lookup is safe
+// to call from any number of threads without locking.
+class TypeProvider {
+	private:
+	blender_blend_t::dna1_body_t *dna;
+	std::vector<std::unique_ptr<BlendType>> types; // owns the types of the lookups below
+	std::map<std::string, BlendType*> typesByName;
+	std::map<int, std::string> typesBySdnaIndex;
+	std::map<std::string, int> sdnaIndexesByType;
+	std::map<std::string, int> typeLengths;
+	std::vector<BlendType*> typesBySdnaIndexFinal;
+	bool finalized = false;
+
+	public:
+	int pointerSize;
+	TypeProvider(blender_blend_t &data);
+	// Types from a DNA1 body parsed on its own, without the rest of the file
+	TypeProvider(blender_blend_t::dna1_body_t *dna, int pointerSize);
+
+	void load(blender_blend_t::dna1_body_t *dna);
+
+	// Compiles every struct type, which also reads each lazily parsed DNA name and type
+	// once. Call before the file is read from more than one thread.
+	void finalize();
+
+	int getTypeLength(const std::string &name);
+	BlendType* getType(int sdnaIndex);
+	BlendType* getType(const std::string &name);
+
+	// Flattens every field, including the fields of nested structs, into the type's table
+	// of paths
+	void compileLayout(BlendType *type);
+};
+
+// Block bodies of a streamed file. Bodies are read from the file on first use and
+// evicted least recently used first once the resident bodies exceed the memory budget,
+// to be read again when next needed. Bodies used while a Scope is open stay pinned
+// until it closes, so the parts and arrays taken from them stay valid meanwhile.
+class BlockCache {
+	public:
+	class Entry {
+		public:
+		std::string body;
+		size_t fileOffset;
+		size_t size;
+		bool resident;
+		bool pinned;
+		std::list<Entry*>::iterator position;
+	};
+
+	class Scope {
+		private:
+		BlockCache *cache;
+		public:
+		Scope(BlockCache *cache);
+		~Scope();
+	};
+
+	private:
+	std::mutex mutex;
+	std::ifstream stream;
+	std::string path;
+	size_t memoryBudget;
+	size_t residentSize;
+	size_t peakSize;
+	unsigned int loadCount;
+	unsigned int evictionCount;
+	int scopeDepth;
+	std::vector<std::unique_ptr<Entry>> entries;
+	std::list<Entry*> recent;
+	std::vector<Entry*> pinnedEntries;
+
+	void evict(Entry *keep);
+	void beginScope();
+	void endScope();
+
+	public:
+	BlockCache(std::string path, size_t memoryBudget);
+	Entry* add(size_t fileOffset, size_t size);
+	const char* get(Entry *entry);
+	size_t getMemoryBudget();
+
+	// Bodies that are pinned at the same time are kept even above the budget, so the
+	// peak can be larger than it
+	size_t getPeakSize();
+	void printStatistics();
+};
+
+class DataSource {
+	private:
+	std::string raw_body;
+	BlockCache *cache;
+	BlockCache::Entry *entry;
+	public:
+	DataSource(std::string raw_body);
+	// A body that stays in the file until it is read through cache
+	DataSource(BlockCache *cache, BlockCache::Entry *entry);
+	const char* getData();
+	size_t getSize();
+	// Where the body starts in the .blend file when it is read through a cache, else -1
+	long long getFileOffset();
+};
+
+// A typed cursor into block memory. It is trivially copyable and reads straight from
+// the bytes owned by the block's DataSource, so parts are passed around by value.
+class DataPart {
+	private:
+	TypeProvider *typeProvider;
+	const char *data;
+	size_t size;
+	size_t offset;
+
+	const char* getAddress(int fieldOffset, size_t length) const;
+
+	template<typename T>
+	T read(const std::string &name, unsigned int arrayIndex, const char *typeName) const {
+		auto fieldOffset = type->getOffset(name);
+
+		auto size = this->typeProvider->getTypeLength(typeName);
+
+		if(size != sizeof(T)){
+			char message[100];
+			sprintf(message, "%s sizes other than %i bytes are not supported (was %i)", typeName, (int)sizeof(T), size);
+			throw std::runtime_error(std::string(message));
+		}
+
+		T value;
+		memcpy(&value, getAddress(fieldOffset + arrayIndex * size, size), size);
+		return value;
+	}
+
+	public:
+	BlendType *type;
+	DataPart();
+	DataPart(TypeProvider *typeProvider, DataSource *dataSource, size_t offset, BlendType *type);
+
+	// The same cursor over the current bytes of dataSource, for streamed bodies that may
+	// have been read again since the part was taken
+	DataPart rebind(DataSource *dataSource) const;
+
+	const char* getData() const;
+	DataPart getPart(const std::string &name) const;
+	int32_t getInt(const std::string &name, unsigned int arrayIndex = 0) const;
+	int32_t getShort(const std::string &name, unsigned int arrayIndex = 0) const;
+	int32_t getChar(const std::string &name, unsigned int arrayIndex = 0) const;
+	float getFloat(const std::string &name, unsigned int arrayIndex = 0) const;
+	std::string getString(const std::string &name) const;
+	unsigned long long getPointer(const std::string &name) const;
+};
+
+class DataBlock {
+	public:
+	std::unique_ptr<DataSource> dataSource;
+	DataPart part;
+	int index;
+	std::string code;
+	unsigned long long memaddr;
+	unsigned int count;
+	DataBlock(DataSource *dataSource, DataPart part, unsigned int index, std::string code, unsigned long long memaddr, unsigned int count);
+
+	// The part over the whole block, reading a streamed body back in if it was evicted
+	DataPart getPart();
+};
+
+// A run of consecutive structs inside a block, read in bulk straight from block memory
+class DataArray {
+	public:
+	DataBlock *block;
+	BlendType *type;
+	const char *data;
+	int count;
+	DataArray();
+	DataArray(DataBlock *block, BlendType *type, size_t offset);
+};
+
+class BlockHeader {
+	public:
+	std::string code;
+	unsigned long long memaddr;
+	int sdnaIndex;
+	unsigned int count;
+	size_t offset;
+	size_t size;
+};
+
+// The block table of a .blend file, kept in a .blendidx sidecar next to it, so later
+// runs can find blocks without walking the block chain. A sidecar is only used while
+// the file's size, modification time and a hash of its first and last 64 KB match.
+class BlockIndex {
+	private:
+	static constexpr uint32_t formatVersion = 3;
+	static constexpr uint64_t hashedBytes = 1 << 16;
+
+	class FileStamp {
+		public:
+		uint64_t size = 0;
+		int64_t modified = 0; // in nanoseconds, so a rewrite within the same second shows
+		uint64_t hash = 0;
+
+		bool operator==(const FileStamp &other) const;
+	};
+
+	// FNV-1a over both ends of the file; hashing all of it would cost the full read the
+	// sidecar is there to avoid
+	static bool getStamp(std::string path, FileStamp &stamp);
+
+	template<typename T>
+	static void put(std::string &result, T value){
+		result.append((const char*)&value, sizeof(value));
+	}
+
+	template<typename T>
+	static T take(const std::string &contents, size_t &offset){
+		T value;
+
+		if(offset + sizeof(value) > contents.size()){
+			throw std::runtime_error("Block index is truncated");
+		}
+
+		memcpy(&value, contents.data() + offset, sizeof(value));
+		offset += sizeof(value);
+		return value;
+	}
+
+	static std::string take(const std::string &contents, size_t &offset, size_t length);
+
+	public:
+	int pointerSize = 0;
+	char endian = 'v'; // as in the file header: v for little, V for big endian
+	std::string version;
+	std::vector<BlockHeader> headers;
+
+	static std::string getPath(std::string blendPath);
+
+	// Fills the index from the sidecar of blendPath; false when there is none, or it no
+	// longer matches the file
+	bool read(std::string blendPath);
+
+	bool write(std::string blendPath);
+};
+
+// Reads the file header and every block header of a .blend file, skipping over the
+// block bodies, or takes them from a block index. Only the DNA1 body is read, and
+// parsed on its own for the types.
+class BlockScanner {
+	private:
+	std::string dnaBody;
+	std::unique_ptr<kaitai::kstream> dnaStream;
+
+	void parseDna(std::string path);
+
+	public:
+	int pointerSize;
+	char endian;
+	std::string version;
+	std::vector<BlockHeader> headers;
+	std::unique_ptr<blender_blend_t::dna1_body_t> dna;
+	BlockScanner(std::string path, BlockIndex &index);
+	BlockScanner(std::string path);
+	BlockIndex getIndex();
+};
+
+bool blockAddressComparer (const DataBlock *a, const DataBlock *b);
+
+// Owns every block of the file. Block bodies are copied out of the parse tree once, and
+// pointers are resolved with a binary search over the blocks sorted by address.
+class BlockProvider {
+	private:
+	TypeProvider *typeProvider;
+	std::vector<std::unique_ptr<DataBlock>> blocks;
+	std::vector<DataBlock*> blocksByAddress;
+
+	public:
+	int pointerSize;
+	BlockProvider(TypeProvider *typeProvider, blender_blend_t &data);
+	// Blocks whose bodies stay in the file and are read through cache when used. Their
+	// parts hold no data until taken with DataBlock::getPart().
+	BlockProvider(TypeProvider *typeProvider, BlockScanner &scanner, BlockCache *cache);
+
+	void addBlock(DataSource *dataSource, DataPart part, std::string code, unsigned long long position, unsigned int count);
+	std::vector<DataBlock*> getBlocks();
+	DataBlock* getBlock(unsigned long long pointer);
+
+	// Like getBlock, but returns nullptr for pointers outside of every block
+	DataBlock* findBlock(unsigned long long pointer);
+
+	DataBlock* getBlock(std::string code);
+	std::vector<DataBlock*> getBlocks(std::string code, size_t maxCount = SIZE_MAX);
+};
+
+// Iterates the nodes of a ListBase through the next pointer that starts every Link
+// struct. Each node's type comes from the SDNA index of the block it lives in. The node
+// after the current one is resolved, and its memory prefetched, while the caller works
+// on the current one. Cycles are caught with Brent's algorithm.
+class ListBaseRange {
+	private:
+	TypeProvider *typeProvider;
+	BlockProvider *blockProvider;
+	unsigned long long first;
+
+	public:
+	class iterator {
+		private:
+		TypeProvider *typeProvider;
+		BlockProvider *blockProvider;
+		unsigned long long address;
+		DataPart current;
+		unsigned long long nextAddress;
+		DataPart next;
+		unsigned long long tortoise;
+		size_t power;
+		size_t length;
+
+		DataPart resolve(unsigned long long address);
+		unsigned long long getNextAddress(const DataPart &part);
+
+		public:
+		iterator(TypeProvider *typeProvider, BlockProvider *blockProvider, unsigned long long address);
+		DataPart operator*() const;
+		iterator& operator++();
+		bool operator!=(const iterator &other) const;
+		unsigned long long getAddress() const;
+	};
+
+	ListBaseRange(TypeProvider *typeProvider, BlockProvider *blockProvider, unsigned long long first);
+	iterator begin();
+	iterator end();
+};
+
+class PointedDataProvider {
+	private:
+	TypeProvider *typeProvider;
+	BlockProvider *blockProvider;
+	public:
+	PointedDataProvider(TypeProvider *typeProvider, BlockProvider *blockProvider);
+	DataPart getPointedData(const DataPart &dataPart, const std::string &name, unsigned int arrayIndex = 0);
+	DataArray getPointedArray(const DataPart &dataPart, const std::string &name);
+	// Untyped data behind a pointer, for arrays that are not written as SDNA structs
+	const char* getPointedBytes(const DataPart &dataPart, const std::string &name, size_t &size);
+	ListBaseRange getList(const DataPart &dataPart, const std::string &name);
+};
+
+// A parsed .blend file together with its providers
+class BlendFile {
+	private:
+	std::unique_ptr<kaitai::kstream> stream;
+
+	void load(const std::string &contents);
+
+	public:
+	std::string path;
+	std::unique_ptr<blender_blend_t> data;
+	std::unique_ptr<BlockScanner> scanner;
+	std::unique_ptr<BlockCache> cache;
+	std::unique_ptr<TypeProvider> typeProvider;
+	std::unique_ptr<BlockProvider> blockProvider;
+	std::unique_ptr<PointedDataProvider> pointedDataProvider;
+	BlendFile(std::string path);
+	BlendFile(std::string path, const std::string &contents);
+	// Streams the file: only block headers and DNA1 are read up front, and block bodies
+	// are read on demand while at most about memoryBudget bytes of them are kept. There is
+	// no parse tree, so data stays empty. The block headers come from the file's block
+	// index when it has a current one.
+	BlendFile(std::string path, size_t memoryBudget);
+};
+
+// Parsed files shared across the whole process, so a library linked from many files
+// is read and parsed once. Files stay cached while anyone holds them, and until
+// collect() finds the cache to be their last owner. A file is streamed when opened with
+// a memory budget; whoever opens it first decides how it is read.
+class BlendFileCache {
+	private:
+	std::mutex mutex;
+	std::map<std::string, std::shared_future<std::shared_ptr<BlendFile>>> files;
+
+	static std::string getKey(std::string path);
+
+	public:
+	static BlendFileCache& getShared();
+	std::shared_ptr<BlendFile> open(std::string path, size_t memoryBudget = 0);
+	void collect();
+};
+
+// An ID block, possibly found in a library file that is kept alive by `library`
+class LinkedId {
+	public:
+	std::shared_ptr<BlendFile> library;
+	BlendFile *file;
+	DataBlock *block;
+	LinkedId(std::shared_ptr<BlendFile> library, BlendFile *file, DataBlock *block);
+};
+
+// Resolves IDs linked from libraries. A linked ID is written as a placeholder block
+// (code "ID") holding only the ID header, whose lib pointer leads to the Library block
+// with the library's path. Libraries of a streamed file are streamed with its memory
+// budget.
+class LibraryLinker {
+	private:
+	BlendFile *file;
+	BlendFileCache *cache;
+
+	public:
+	LibraryLinker(BlendFile *file, BlendFileCache *cache);
+	std::string getLibraryPath(const DataPart &library);
+
+	// Placeholders of linked IDs whose name starts with code, "ME" for meshes
+	std::vector<DataBlock*> getLinkedIds(std::string code);
+
+	LinkedId resolve(DataBlock *placeholder);
+};
+
+// Converts Blender loop UVs into PIE texture coordinates: PIE has its origin in the top
+// left corner of the texture page, so V is flipped, and both axes are scaled to the page
+// size (1 for PIE 3 normalized coordinates, the page size in pixels for PIE 2).
+class UVConverter {
+	private:
+	float pageWidth;
+	float pageHeight;
+
+	public:
+	UVConverter(float pageWidth, float pageHeight);
+	std::vector<float> convert(const DataArray &mloopuv, int loopCount);
+
+	// Converts (u, v) float pairs that are stride bytes apart, as stored in generic
+	// float2 attribute layers
+	void convert(const char *source, int stride, int loopCount, std::vector<float> &result);
+};
+
+// Set on the threads of parallelForChunks. Loops nested in a parallel loop, like the
+// kernels of meshes extracted in parallel, run serially on the worker they are called
+// from instead of starting threads of their own.
+extern thread_local bool insideParallelFor;
+
+// Runs function(begin, end) over [0, count) split into one contiguous chunk per thread.
+// Chunks are numbered in order, so callers can keep per-chunk results (see
+// parallelPrefixSum).
+template<typename Function>
+void parallelForChunks(size_t count, size_t minChunkSize, Function function){
+	size_t threads = std::thread::hardware_concurrency();
+
+	if(threads < 1){
+		threads = 1;
+	}
+	if(minChunkSize < 1){
+		minChunkSize = 1;
+	}
+	if(threads > count / minChunkSize){
+		threads = count / minChunkSize;
+	}
+	if(threads <= 1 || insideParallelFor){
+		function(0, count, 0);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	size_t chunkSize = (count + threads - 1) / threads;
+	auto subsystem = (MemorySubsystem)MemoryTracker::current;
+
+	for(size_t chunk = 0; chunk < threads; chunk++){
+		size_t begin = chunk * chunkSize;
+		size_t end = std::min(count, begin + chunkSize);
+
+		// Workers allocate on behalf of the caller's subsystem
+		workers.push_back(std::thread([function, subsystem](size_t begin, size_t end, size_t chunk){
+			MemoryScope scope(subsystem);
+			insideParallelFor = true;
+			function(begin, end, chunk);
+		}, begin, end, chunk));
+	}
+
+	for(auto &worker : workers){
+		worker.join();
+	}
+}
+
+template<typename Function>
+void parallelFor(size_t count, size_t minChunkSize, Function function){
+	parallelForChunks(count, minChunkSize, [&function](size_t begin, size_t end, size_t){
+		function(begin, end);
+	});
+}
+
+// Turns counts into exclusive offsets in place and returns the total.
+int parallelPrefixSum(std::vector<int> &values);
+
+class ExtractedMesh {
+	public:
+	std::string name;
+	std::vector<float> positions; // x, y, z per vertex
+	std::vector<int> loopVertices; // vertex index per loop
+	std::vector<int> polyLoopStarts;
+	std::vector<int> polyLoopCounts;
+	std::vector<float> uvs; // PIE u, v per loop
+	std::vector<int> triangles; // loop indices, three per triangle
+	std::vector<int> loopEdges; // edge index per loop, empty when not known
+	std::vector<char> sharpEdges; // per edge, empty when none are marked
+	std::vector<char> smoothPolys; // per poly, empty when all are smooth
+	float autoSmoothAngle = -1; // edges with a larger dihedral angle are sharp, if >= 0
+	std::vector<float> vertexNormals; // x, y, z per vertex, filled by NormalGenerator
+	std::vector<float> loopNormals; // x, y, z per loop, filled by NormalGenerator
+
+	int getVertexCount();
+	int getLoopCount();
+	int getPolyCount();
+	int getTriangleCount();
+};
+
+// Layer types from Blender's eCustomDataType that the extractor reads
+enum CustomDataType {
+	CD_PROP_INT32 = 11,
+	CD_MLOOPUV = 16,
+	CD_PROP_FLOAT3 = 48,
+	CD_PROP_FLOAT2 = 49,
+	CD_PROP_BOOL = 50
+};
+
+class AttributeLayer {
+	public:
+	std::string name;
+	int type;
+	const char *data;
+	size_t size;
+	AttributeLayer();
+};
+
+// Reads the layers of a CustomData struct (vdata, ldata, ... or vert_data, corner_data, ...
+// since Blender 4.0), where Blender 3.x and later keep positions, corner vertices and UV
+// maps as generic named attributes.
+class CustomDataReader {
+	private:
+	PointedDataProvider *pointedDataProvider;
+	std::map<std::pair<const char*, std::string>, std::vector<AttributeLayer>> layersByCustomData;
+
+	public:
+	CustomDataReader(PointedDataProvider *pointedDataProvider);
+	std::vector<AttributeLayer> getLayers(const DataPart &owner, const std::string &customData);
+
+	// Finds a layer by name and type; an empty name matches the first layer of that type
+	// whose name does not start with '.', the prefix Blender uses for internal attributes.
+	// The layers of each CustomData are read on the first lookup and kept for later ones.
+	AttributeLayer findLayer(const DataPart &owner, const std::string &customData, const std::string &name, int type);
+};
+
+// Reads the geometry of a Mesh block into flat arrays, copying each array out of its
+// block in one pass instead of going through a DataPart per element.
+class MeshExtractor {
+	private:
+	PointedDataProvider *pointedDataProvider;
+
+	template<typename T>
+	static void gather(const DataArray &array, std::string fieldName, int count, int components, std::vector<T> &result){
+		if(array.data == nullptr || array.count < count){
+			char data[100];
+			sprintf(data, "Mesh data holds fewer than the %i expected elements", count);
+			throw std::runtime_error(std::string(data));
+		}
+
+		gather(array.data + array.type->getOffset(fieldName), array.type->size, count, components, result);
+	}
+
+	template<typename T>
+	static void gather(const AttributeLayer &layer, int count, int components, std::vector<T> &result){
+		if(layer.data == nullptr || layer.size < count * components * sizeof(T)){
+			char data[100];
+			sprintf(data, "Attribute %s holds fewer than the %i expected elements", layer.name.c_str(), count);
+			throw std::runtime_error(std::string(data));
+		}
+
+		gather(layer.data, components * sizeof(T), count, components, result);
+	}
+
+	template<typename T>
+	static void gather(const char *source, int stride, int count, int components, std::vector<T> &result){
+		result.resize(count * components);
+
+		for(int i = 0; i < count; i++){
+			memcpy(&result[i * components], source + i * stride, sizeof(T) * components);
+		}
+	}
+
+	// Reads the first of several names a field has had across Blender versions
+	static std::string findPath(const DataPart &part, std::vector<std::string> names);
+
+	static bool hasPointer(const DataPart &part, const std::string &name);
+
+	// Reads what splits normals: the edge of every loop, sharp edges and flat polygons.
+	// Before Blender 4.1, sharp edges only count with auto smooth, which also makes edges
+	// sharper than its angle sharp.
+	void readShading(const DataPart &mesh, CustomDataReader &customData, ExtractedMesh *result);
+
+	public:
+	MeshExtractor(PointedDataProvider *pointedDataProvider);
+
+	// Reads each array from its legacy struct array when the file has one (Blender 2.x up to
+	// 3.x), and from generic attribute layers otherwise, so files from any version in between
+	// end up in the same bulk arrays.
+	std::unique_ptr<ExtractedMesh> extract(const DataPart &mesh);
+};
+
+class Bounds {
+	public:
+	float minimum[3] = { 0, 0, 0 };
+	float maximum[3] = { 0, 0, 0 };
+	float radius = 0; // around the origin
+};
+
+// Moves positions from object space into PIE game units in a single pass over the
+// position array: applies the object matrix, the unit scale and the swap from Blender's
+// Z-up to the game's Y-up (x, z, -y), snaps to the quantization grid, and measures the
+// bounding box and radius on the way. Mirroring matrices also reverse every polygon's
+// winding, so faces keep pointing outwards.
+class PositionTransformer {
+	private:
+	float matrix[16]; // column-major, like Blender's obmat
+	float step;
+
+	void reverseWindings(ExtractedMesh *mesh);
+
+	public:
+	// objectMatrix may be nullptr for meshes without an object; scale is game units per
+	// Blender unit, and step the quantization grid, or 0 to keep full precision
+	PositionTransformer(const float *objectMatrix, float scale, float step);
+
+	bool isMirrored();
+	Bounds transform(ExtractedMesh *mesh);
+};
+
+// Splits every polygon into triangles. Convex polygons are fanned from their first
+// corner, concave ones are ear clipped in the plane of the polygon. Each polygon's
+// slots in the output are found with a prefix sum over its triangle count, so
+// polygons are triangulated in parallel straight into one buffer.
+class Triangulator {
+	private:
+	static void getPoint(ExtractedMesh *mesh, int loop, float *point);
+
+	// Projects the polygon onto the plane that drops its normal's largest axis
+	static void project(ExtractedMesh *mesh, int loopStart, int loopCount, std::vector<float> &points);
+
+	static float cross(const float *a, const float *b, const float *c);
+	static bool isConvex(std::vector<float> &points, int count);
+	static bool isInside(const float *p, const float *a, const float *b, const float *c);
+	static void fan(int loopStart, int loopCount, int *target);
+	static void clipEars(std::vector<float> &points, int loopStart, int loopCount, int *target);
+
+	public:
+	static void triangulate(ExtractedMesh *mesh);
+};
+
+// Computes area weighted normals. Face normals are the sum of SSE cross products over
+// each polygon's fan, so their length is twice the polygon's area. Vertex normals add
+// them up per thread in private accumulators that are reduced afterwards, so no two
+// threads ever write the same memory. Loops of smooth polygons take their vertex's
+// normal, unless sharp edges, flat polygons or non-manifold edges split the polygons
+// around the vertex into separate smooth fans.
+class NormalGenerator {
+	private:
+#ifdef __SSE2__
+	static __m128 cross(__m128 a, __m128 b);
+	static __m128 normalize(__m128 v);
+#endif
+
+	// Writes the normalized x, y, z of a padded vector to target
+	static void storeNormalized(const float *vector, float *target);
+
+	static void getFaceNormal(const float *points, const int *loopVertices, int loopCount, float *normal);
+	static void add(float *target, const float *value);
+	static int find(std::vector<int> &parents, int loop);
+	static void unite(std::vector<int> &parents, int a, int b);
+
+	// Groups the loops around each vertex into smooth fans, joining the loops on both
+	// sides of every edge that does not split normals. Returns false when no edge splits,
+	// and every loop can use its vertex normal.
+	static bool findSmoothFans(ExtractedMesh *mesh, const std::vector<float> &faceNormals, const std::vector<int> &loopPolys, std::vector<int> &parents);
+
+	public:
+	static void generate(ExtractedMesh *mesh);
+
+	// Packs the loop normals in triangle order, three corners per triangle, as PIE 4
+	// NORMALS lists them
+	static std::vector<float> pack(ExtractedMesh *mesh);
+};
+
+// Reduces a triangulated mesh towards a target triangle count with quadric error
+// metrics (Garland & Heckbert), collapsing the cheapest edge first from a heap. Vertices
+// on open borders, UV seams and sharp edges are locked in place, so outlines, texture
+// islands and hard edges keep their shape; a collapse only ever moves an unlocked vertex
+// onto a neighbour. When nothing unlocked is left to collapse above the target, the
+// locks are lifted, so every level still reaches its target. Each level keeps which
+// triangles are smooth and which edges are sharp, so its normals can be computed from
+// its own geometry.
+class MeshSimplifier {
+	private:
+	class Quadric {
+		public:
+		double q[10] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+		void addPlane(double a, double b, double c, double d, double weight);
+		void add(const Quadric &other);
+		double evaluate(const float *p) const;
+	};
+
+	class Collapse {
+		public:
+		double cost;
+		int from;
+		int to;
+		unsigned int fromVersion;
+		unsigned int toVersion;
+		bool operator<(const Collapse &other) const;
+	};
+
+	std::vector<float> positions;
+	std::vector<int> corners; // vertex per triangle corner
+	std::vector<float> cornerUVs;
+	std::vector<char> triangleSmooth;
+	std::set<std::pair<int, int>> sharpEdges; // vertex pairs, smallest first
+	float autoSmoothAngle;
+	std::vector<char> triangleRemoved;
+	std::vector<std::vector<int>> vertexTriangles;
+	std::vector<Quadric> quadrics;
+	std::vector<char> locked;
+	bool unlocked = false; // set once locked vertices may move too
+	std::vector<unsigned int> versions;
+	std::priority_queue<Collapse> heap;
+	int triangleCount;
+
+	static void getNormal(const float *a, const float *b, const float *c, double *normal);
+	const float* getPosition(int vertex);
+	int findCorner(int triangle, int vertex);
+	void pushCollapse(int from, int to);
+	void pushCollapses(int vertex);
+
+	// Remembers which triangles are smooth and which vertex pairs are sharp edges, and
+	// locks the vertices of sharp edges
+	void readShading(ExtractedMesh *mesh);
+
+	void getNeighbours(int vertex, std::vector<int> &result);
+	bool canCollapse(int from, int to);
+	void collapse(int from, int to);
+
+	public:
+	MeshSimplifier(ExtractedMesh *mesh);
+	std::unique_ptr<ExtractedMesh> simplify(int targetTriangleCount);
+};
+
+// Builds the detail levels of every mesh, each level simplified from the one before it.
+// Meshes are independent of each other, so they are processed in parallel.
+class LodGenerator {
+	public:
+	static std::vector<std::vector<std::unique_ptr<ExtractedMesh>>> generate(std::vector<ExtractedMesh*> meshes, std::vector<int> targetTriangleCounts);
+};
+
+// Reorders triangles for the GPU post-transform vertex cache with Tom Forsyth's linear
+// speed algorithm, then renumbers vertices in the order they are first used so vertex
+// fetches run through memory front to back.
+class VertexCacheOptimizer {
+	private:
+	static const int cacheSize = 32;
+
+	static float getVertexScore(int cachePosition, int remainingTriangles);
+	static std::vector<int> getTriangleVertices(ExtractedMesh *mesh);
+
+	public:
+	// Average cache miss ratio: transformed vertices per triangle with a FIFO cache
+	static float getACMR(ExtractedMesh *mesh, int fifoSize = 16);
+
+	static void optimize(ExtractedMesh *mesh);
+};
+
+// An F-Curve evaluated the way Blender does for constant, linear and Bezier keyframes.
+// Outside of its keyframes the curve holds the first or last value.
+class AnimationCurve {
+	private:
+	// Per keyframe: left handle, key and right handle as (frame, value) pairs
+	std::vector<float> points;
+	std::vector<char> interpolations;
+
+	enum {
+		BEZT_IPO_CONST = 0,
+		BEZT_IPO_LIN = 1
+	};
+
+	static float bezier(float a, float b, float c, float d, float t);
+
+	public:
+	std::string path;
+	int arrayIndex;
+	AnimationCurve(std::string path, int arrayIndex);
+
+	// vec is BezTriple::vec: rows of (frame, value, unused) for the left handle, the key
+	// and the right handle
+	void addKey(const float vec[9], char interpolation);
+
+	float evaluate(float frame) const;
+};
+
+// Reads the F-Curves of the action assigned to an ID through its AnimData
+class ActionReader {
+	private:
+	PointedDataProvider *pointedDataProvider;
+
+	public:
+	ActionReader(PointedDataProvider *pointedDataProvider);
+	std::vector<AnimationCurve> read(const DataPart &id);
+};
+
+// Blends the relative shape keys of a mesh: each key moves the vertices by its weight
+// times its offset from the key it is relative to. The key data is read once and shared
+// by every evaluation.
+class ShapeKeyEvaluator {
+	private:
+	std::vector<std::string> names;
+	std::vector<std::vector<float>> positions;
+	std::vector<int> relativeTo;
+	std::vector<float> values;
+	std::vector<bool> muted;
+	std::vector<AnimationCurve> curves;
+	int reference;
+	bool relative;
+
+	enum {
+		KEY_RELATIVE = 1,
+		KEYBLOCK_MUTE = 1 << 0
+	};
+
+	public:
+	ShapeKeyEvaluator(PointedDataProvider *pointedDataProvider, const DataPart &mesh);
+	bool hasKeys();
+
+	// Blended positions at frame; keys whose value is animated take it from the Key's
+	// action ("key_blocks[\"name\"].value"), the others keep their current value
+	std::vector<float> evaluate(float frame);
+};
+
+class AnimationFrame {
+	public:
+	float location[3];
+	float rotation[3];
+	float scale[3];
+};
+
+class AnimationTrack {
+	public:
+	int frameTime; // milliseconds
+	std::vector<AnimationFrame> frames;
+
+	// Moves the frames into the space PositionTransformer puts positions in: scale is game
+	// units per Blender unit, and Blender's axes (x, y, z) become (x, z, -y)
+	void transform(float scale);
+};
+
+// Evaluates an object's location, Euler rotation and scale over a range of frames.
+// Channels without an F-Curve keep the object's own values.
+class ObjectAnimator {
+	private:
+	AnimationFrame base;
+	std::vector<AnimationCurve> curves;
+
+	public:
+	ObjectAnimator(PointedDataProvider *pointedDataProvider, const DataPart &object);
+	bool isAnimated();
+	AnimationFrame evaluate(float frame) const;
+
+	// Frames are independent, so they are evaluated in parallel
+	AnimationTrack evaluate(int frameStart, int frameEnd, float framesPerSecond) const;
+};
+
+// Evaluates the Mirror and Array modifiers of an object on its extracted mesh, in stack
+// order, so models need not have their modifiers applied in Blender first. A modifier
+// grows the mesh arrays to hold all of its copies at once and fills the copies in
+// parallel, then welds the vertices it merges in a single pass. Other modifiers are
+// skipped with a warning.
+class ModifierEvaluator {
+	private:
+	PointedDataProvider *pointedDataProvider;
+	DataPart object;
+	std::string objectName;
+	WarningLog *warnings;
+
+	enum {
+		eModifierType_Mirror = 5,
+		eModifierType_Array = 12,
+		eModifierMode_Realtime = 1 << 0,
+		MOD_MIR_MIRROR_U = 1 << 1,
+		MOD_MIR_MIRROR_V = 1 << 2,
+		MOD_MIR_AXIS_X = 1 << 3,
+		MOD_MIR_NO_MERGE = 1 << 7,
+		MOD_ARR_OFF_CONST = 1 << 0,
+		MOD_ARR_OFF_RELATIVE = 1 << 1,
+		MOD_ARR_OFF_OBJ = 1 << 2,
+		MOD_ARR_MERGE = 1 << 0,
+		MOD_ARR_MERGEFINAL = 1 << 1,
+		MOD_ARR_FITLENGTH = 1
+	};
+
+	// Copy c of the mesh has positions p * scale + offset, and texture coordinates
+	// uv * uvScale + uvOffset (in PIE space, v running down)
+	class CopyTransform {
+		public:
+		float scale[3] = { 1, 1, 1 };
+		float offset[3] = { 0, 0, 0 };
+		float uvScale[2] = { 1, 1 };
+		float uvOffset[2] = { 0, 0 };
+
+		bool isMirrored() const;
+	};
+
+	static int getEdgeCount(ExtractedMesh *mesh);
+
+	// Appends copies 1..n-1 of the mesh after itself; copy 0 must be the identity. Loops
+	// of mirrored copies run backwards so their faces keep pointing outwards.
+	static void replicate(ExtractedMesh *mesh, const std::vector<CopyTransform> &copies);
+
+	// For each vertex of the count vertices at to, a vertex at from that is at most
+	// distance away, or -1
+	static std::vector<int> findDoubles(ExtractedMesh *mesh, int from, int to, int count, float distance);
+
+	// Replaces every vertex v with targets[v], which is never larger than v, then drops
+	// the loops of edges that collapsed and polygons left with fewer than three loops.
+	// Edges are found again from their vertices, so merged seams join their faces.
+	static void weld(ExtractedMesh *mesh, std::vector<int> &targets);
+
+	void mirror(ExtractedMesh *mesh, const DataPart &modifier);
+	void array(ExtractedMesh *mesh, const DataPart &modifier);
+
+	public:
+	ModifierEvaluator(PointedDataProvider *pointedDataProvider, const DataPart &object, WarningLog *warnings);
+	void evaluate(ExtractedMesh *mesh);
+};
+
+// Writes triangulated meshes as PIE 3 models, or PIE 4 with their loop normals
+class PieWriter {
+	private:
+	std::string texture;
+
+	static void append(std::string &result, const char *format, ...);
+
+	public:
+	int version;
+	PieWriter(std::string texture, int version = 3);
+	std::string write(ExtractedMesh *mesh);
+
+	// An animation, when given, moves every level; PIE animates whole levels only
+	std::string write(std::vector<ExtractedMesh*> levels, const AnimationTrack *animation = nullptr);
+};
+
+// Writes the triangles of a mesh as Wavefront OBJ, with a texture coordinate and,
+// when generated, a normal per corner
+class ObjWriter {
+	private:
+	std::string texture;
+
+	static void append(std::string &result, const char *format, ...);
+
+	public:
+	ObjWriter(std::string texture);
+	std::string write(ExtractedMesh *mesh, std::string name);
+};
+
+// Writes the triangles of a mesh as a self-contained glTF 2.0 file, with its buffer
+// embedded as a base64 data URI. glTF keeps one set of attributes per vertex, so every
+// loop becomes a vertex and the triangles index loops.
+class GltfWriter {
+	private:
+	std::string texture;
+
+	static void append(std::string &result, const char *format, ...);
+	static void appendBase64(std::string &result, const std::vector<char> &data);
+
+	// JSON string contents, for names taken from the file
+	static std::string escape(const std::string &text);
+
+	public:
+	GltfWriter(std::string texture);
+	std::string write(ExtractedMesh *mesh, std::string name);
+};
+
+std::string getBaseName(std::string path);
+
+// The texture of models without an atlas: the file name of the first image with a file
+// or packed data, as TextureUnpacker writes it
+std::string findTextureName(BlendFile &file);
+
+// Writes the images packed into a file to a directory, named like the image so the
+// PIE TEXTURE line finds them. The bytes go straight from block memory to the output
+// file; bodies of streamed files are not read at all, but copied from the .blend file
+// inside the kernel with copy_file_range.
+class TextureUnpacker {
+	private:
+	BlendFile *file;
+
+	static bool writeAll(int output, const char *data, size_t size);
+	static bool copyAll(int input, off_t offset, int output, size_t size);
+	bool unpack(const DataPart &packedFile, std::string path);
+
+	public:
+	bool verbose = true; // lists the images written
+
+	TextureUnpacker(BlendFile *file);
+
+	// Finds the packed file of an image, with the path it was packed from when the file
+	// keeps one; false when the image is not packed
+	static bool findPackedFile(PointedDataProvider &pointedDataProvider, const DataPart &image, DataPart &packedFile, std::string &packedPath);
+
+	// The extension of the packed path, else of the format the packed bytes start with
+	static std::string getPackedExtension(PointedDataProvider &pointedDataProvider, const DataPart &packedFile, const std::string &packedPath);
+
+	// The file name of an image, as written by unpack and on the PIE TEXTURE line: its
+	// path or packed path without directories, else its ID name with the extension of
+	// its packed file
+	static std::string getFileName(PointedDataProvider &pointedDataProvider, const DataPart &image);
+
+	// Returns the number of images written
+	int unpack(std::string directory);
+};
+
+// Packs rectangles into a page of fixed size. The top of the packed area is kept as a
+// skyline of horizontal segments, and each rectangle goes where its far edge ends up
+// lowest (the bottom-left rule), with y growing downwards like image rows.
+class SkylinePacker {
+	private:
+	class Segment {
+		public:
+		int x;
+		int y;
+		int width;
+	};
+
+	int width;
+	int height;
+	std::vector<Segment> skyline;
+
+	// The y a rectangle needs when its left edge is at the segment at index, or -1
+	int fit(size_t index, int rectWidth, int rectHeight);
+
+	public:
+	SkylinePacker(int width, int height);
+	bool insert(int rectWidth, int rectHeight, int &x, int &y);
+};
+
+class AtlasImage {
+	public:
+	std::string name; // as PIE TEXTURE lines name it, empty when the mesh has no image
+	int width = 0;
+	int height = 0; // 0 when the size could not be read
+};
+
+// A rectangle of a source image, with padding, and where it went in the atlas
+class AtlasRegion {
+	public:
+	std::string image;
+	int sourceX;
+	int sourceY;
+	int width;
+	int height;
+	int page;
+	int x;
+	int y;
+};
+
+// Gathers the UV islands of all meshes of a file, packs the parts of their images they
+// sample into shared atlas pages and moves their texture coordinates there, so models
+// that used different images can be drawn with one texture. Islands of one mesh always
+// share a page, because a PIE model names one texture. Compositing the pages needs an
+// image codec, which the converter does not have; the manifest lists every region
+// instead, for the texture pipeline to copy.
+class TextureAtlas {
+	private:
+	int pageSize;
+	int padding;
+	WarningLog *warnings;
+	std::vector<SkylinePacker> packers;
+
+	// The pixel rectangle around an island's texture coordinates. Islands that wrap
+	// around the image edge get rectangles beyond it, which the manifest marks.
+	class IslandRect {
+		public:
+		int x0 = INT_MAX;
+		int y0 = INT_MAX;
+		int x1 = INT_MIN;
+		int y1 = INT_MIN;
+
+		bool overlaps(const IslandRect &other) const;
+		void add(const IslandRect &other);
+	};
+
+	static int findRoot(std::vector<int> &parents, int i);
+
+	// Numbers the UV islands of mesh, per loop: polygons are in one island when they
+	// share a vertex with the same texture coordinates there
+	static int findIslands(ExtractedMesh *mesh, std::vector<int> &loopIslands);
+
+	// Finds the island rectangles of a mesh in image pixels and merges those that
+	// overlap, so texels shared by several islands are copied once. Returns the merged
+	// rectangles and the one of each loop.
+	std::vector<IslandRect> findRects(ExtractedMesh *mesh, const AtlasImage &image, std::vector<int> &loopRects);
+
+	// Places the rectangles of one mesh on page, reusing regions already there that
+	// hold the same texels. Leaves the page untouched and returns false when they do
+	// not all fit.
+	bool place(int page, const std::string &image, const std::vector<IslandRect> &rects, std::vector<int> &rectRegions);
+
+	public:
+	std::string name; // pages are written as name-0.png, name-1.png, ...
+	std::vector<AtlasRegion> regions;
+	std::vector<int> meshPages; // per mesh, -1 for meshes that keep their own image
+
+	TextureAtlas(std::string name, int pageSize, WarningLog *warnings, int padding = 2);
+	int getPageCount();
+	std::string getPageName(int page);
+
+	// Reads the size of a PNG file from its IHDR chunk
+	static bool readPngSize(const char *data, size_t size, int &width, int &height);
+
+	// The image the first material of mesh samples: through its first Image Texture node
+	// since Blender 2.80, its first texture slot before. Packed images are sized from
+	// their PNG header, others from the file they name, relative to the .blend file
+	// when the path starts with //.
+	static AtlasImage findImage(BlendFile &file, const DataPart &mesh);
+
+	// Packs the meshes, whose images are given per mesh, and rewrites the texture
+	// coordinates of those that got a page. Meshes without an image of known size, or
+	// whose islands do not fit one page, keep their coordinates.
+	void pack(std::vector<ExtractedMesh*> &meshes, std::vector<AtlasImage> &images);
+
+	// Lists every page and the regions to copy onto it, as JSON
+	std::string writeManifest(std::vector<AtlasImage> &images);
+};
+
+class ConvertOptions {
+	public:
+	std::vector<int> lodTriangleCounts;
+	bool optimizeVertexCache = false;
+	bool normals = false;
+	bool animate = false;
+	int frameStart = 0;
+	int frameEnd = -1; // the scene's range when frameEnd < frameStart
+	bool transform = false;
+	float transformScale = 1; // game units per meter
+	float quantizeStep = 0; // grid for transformed positions, 0 keeps full precision
+	std::vector<std::string> formats = { "pie" }; // file extensions to write
+	bool modifiers = true;
+	bool unpackTextures = false;
+	int atlasSize = 0; // page size of a texture atlas shared by all meshes, 0 for none
+	std::string atlasName = "atlas"; // pages are atlasName-0.png, ...
+	bool verbose = true; // prints statistics of each step
+	WarningLog *warnings = &WarningLog::getShared();
+};
+
+// A mesh ready to be written: its first level is the extracted mesh, the others are
+// simplified from it
+class ExtractedModel {
+	public:
+	std::string name; // without Blender's two letter ID code
+	std::vector<std::unique_ptr<ExtractedMesh>> levels;
+	AnimationTrack animation;
+	Bounds bounds; // of the first level, when positions were transformed
+	std::string texture;
+
+	std::vector<ExtractedMesh*> getLevels();
+};
+
+class ConvertedModel {
+	public:
+	std::string name;
+	std::map<std::string, std::string> outputs; // file contents by extension
+	Bounds bounds; // of the first level, when positions were transformed
+	ConvertedModel(std::string name);
+};
+
+// The object in file that uses the mesh at meshAddress, or nullptr
+DataBlock* findMeshObject(BlendFile &file, unsigned long long meshAddress);
+
+// Receives each model of a file with its index, and the number of models in the file
+typedef std::function<void(ExtractedModel &model, size_t index, size_t count)> ModelVisitor;
+
+// Extracts every mesh of file with its levels and passes it to visit, dropping it once
+// visit returns. Streamed files without an atlas are extracted one mesh at a time. With
+// an atlas, its manifest goes to atlasManifest.
+void extractModels(BlendFile &file, ConvertOptions &options, const ModelVisitor &visit, std::string *atlasManifest = nullptr);
+
+// Extracts every mesh of file with its levels and keeps them all
+std::vector<ExtractedModel> extractModels(BlendFile &file, ConvertOptions &options, std::string *atlasManifest = nullptr);
+
+// Writes a model in one of the formats of ConvertOptions::formats. OBJ and glTF hold the
+// first level only.
+std::string formatModel(ExtractedModel &model, const std::string &format, ConvertOptions &options);
+
+// Extracts every mesh of file once and writes it in each of the requested formats
+std::vector<ConvertedModel> convertModels(BlendFile &file, ConvertOptions &options, std::string *atlasManifest = nullptr);
+
+// Writes the models to path; if a file holds several meshes, each gets its own file
+// with the mesh name appended. Formats other than PIE replace the extension of path.
+bool writeModels(std::string path, std::vector<ConvertedModel> &models);
+
+// Writes the outputs of model to path, with its name appended when appendName is set
+bool writeModel(std::string path, ConvertedModel &model, bool appendName);
+
+// Converts each model of file and writes it to path like writeModels as soon as it is
+// extracted, so a streamed file never holds more than one model and its outputs
+bool convertAndWriteModels(BlendFile &file, ConvertOptions &options, std::string path, std::string *atlasManifest = nullptr);
@@ -0,0 +1,78 @@
+#include "converter.h"
+
+// Checks AnimationCurve against the keyframes of a known object: the default cube with
+// its X location keyed to 0 at frame 1 and to 10 at frame 11, with Blender's default
+// auto clamped handles, stored as the BezTriple rows Blender writes. Also checks that
+// animation frames are transformed like positions.
+
+static int failures = 0;
+
+static void check(const AnimationCurve &curve, float frame, float expected){
+	auto value = curve.evaluate(frame);
+
+	if(fabsf(value - expected) > 0.001f){
+		printf("FAIL %s at frame %g: %g, expected %g\n", curve.path.c_str(), frame, value, expected);
+		failures++;
+	}
+}
+
+int main(){
+	float first[9] = { -2.333333f, 0, 0, 1, 0, 0, 4.333333f, 0, 0 };
+	float second[9] = { 7.666667f, 10, 0, 11, 10, 0, 14.333333f, 10, 0 };
+
+	enum { BEZT_IPO_CONST = 0, BEZT_IPO_LIN = 1, BEZT_IPO_BEZ = 2 };
+
+	AnimationCurve bezier("location", 0);
+	bezier.addKey(first, BEZT_IPO_BEZ);
+	bezier.addKey(second, BEZT_IPO_BEZ);
+
+	check(bezier, 0, 0);
+	check(bezier, 1, 0);
+	check(bezier, 6, 5); // the flat handles make the curve symmetric about its middle
+	check(bezier, 11, 10);
+	check(bezier, 20, 10);
+
+	if(bezier.evaluate(3) >= 2){
+		printf("FAIL location at frame 3: %g, expected to ease in below the linear 2\n", bezier.evaluate(3));
+		failures++;
+	}
+
+	AnimationCurve linear("location", 1);
+	linear.addKey(first, BEZT_IPO_LIN);
+	linear.addKey(second, BEZT_IPO_LIN);
+
+	check(linear, 3, 2);
+	check(linear, 8.5f, 7.5f);
+
+	AnimationCurve constant("location", 2);
+	constant.addKey(first, BEZT_IPO_CONST);
+	constant.addKey(second, BEZT_IPO_CONST);
+
+	check(constant, 10.5f, 0);
+	check(constant, 11, 10);
+
+	// A frame of the cube at (1, 2, 3) turned 90 degrees about Blender's Z axis ends up at
+	// (1, 3, -2) with the turn about the game's Y axis, at 128 game units per meter
+	AnimationTrack track;
+	track.frames.push_back({ { 1, 2, 3 }, { 0, 0, (float)M_PI / 2 }, { 1, 2, 3 } });
+	track.transform(128);
+
+	auto &frame = track.frames[0];
+	float expected[9] = { 128, 384, -256, 0, (float)M_PI / 2, 0, 1, 3, 2 };
+	for(int i = 0; i < 9; i++){
+		float value = i < 3 ? frame.location[i] : i < 6 ? frame.rotation[i - 3] : frame.scale[i - 6];
+
+		if(fabsf(value - expected[i]) > 0.001f){
+			printf("FAIL transformed frame component %i: %g, expected %g\n", i, value, expected[i]);
+			failures++;
+		}
+	}
+
+	if(failures){
+		printf("%i checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,167 @@
+# Checks a batch written as PIE, OBJ and glTF with normals, the object transform and
+# quantization: the models streamed to WORK/export-streamed validate against those of
+# the batch read whole, and every OBJ and glTF file parses, with indices in range and
+# positions on the quantization grid.
+#
+#   cmake -DCONVERT=blender-convert "-DFILES=cube.blend;monkey.blend" -DWORK=dir -P export_test.cmake
+
+set (OPTIONS --normals --transform 1 --quantize 0.5 --formats pie,obj,gltf)
+set (ON_GRID "^-?[0-9]+(\\.5)?$") # multiples of the 0.5 step
+
+function(convert output)
+	file(REMOVE_RECURSE ${output})
+	file(MAKE_DIRECTORY ${output})
+	execute_process(COMMAND ${CONVERT} --batch ${OPTIONS} ${ARGN} --output ${output} ${FILES} RESULT_VARIABLE result OUTPUT_VARIABLE text)
+
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "blender-convert --batch ${ARGN} failed:\n${text}")
+	endif()
+endfunction()
+
+function(check_obj path)
+	file(STRINGS ${path} positions REGEX "^v ")
+	file(STRINGS ${path} uvs REGEX "^vt ")
+	file(STRINGS ${path} normals REGEX "^vn ")
+	file(STRINGS ${path} faces REGEX "^f ")
+	list(LENGTH positions positionCount)
+	list(LENGTH uvs uvCount)
+	list(LENGTH normals normalCount)
+
+	if(positionCount EQUAL 0 OR uvCount EQUAL 0 OR normalCount EQUAL 0 OR NOT faces)
+		message(FATAL_ERROR "${path} lacks positions, texture coordinates, normals or faces")
+	endif()
+
+	foreach(position ${positions})
+		string(REPLACE " " ";" coordinates "${position}")
+		list(REMOVE_AT coordinates 0)
+		foreach(coordinate ${coordinates})
+			if(NOT coordinate MATCHES "${ON_GRID}")
+				message(FATAL_ERROR "${path}: '${position}' is not on the quantization grid")
+			endif()
+		endforeach()
+	endforeach()
+
+	foreach(face ${faces})
+		string(REGEX MATCHALL "[0-9]+/[0-9]+/[0-9]+" corners "${face}")
+		list(LENGTH corners cornerCount)
+		if(NOT cornerCount EQUAL 3)
+			message(FATAL_ERROR "${path}: '${face}' is not a triangle of position/uv/normal corners")
+		endif()
+
+		foreach(corner ${corners})
+			string(REPLACE "/" ";" indices ${corner})
+			list(GET indices 0 position)
+			list(GET indices 1 uv)
+			list(GET indices 2 normal)
+
+			if(position LESS 1 OR position GREATER positionCount OR uv LESS 1 OR uv GREATER uvCount OR normal LESS 1 OR normal GREATER normalCount)
+				message(FATAL_ERROR "${path}: '${face}' is out of range")
+			endif()
+		endforeach()
+	endforeach()
+endfunction()
+
+# Fails unless accessor index of json has count elements of type and component,
+# filling a bufferView of matching length
+function(check_accessor path json index count type component size)
+	string(JSON actualCount GET "${json}" accessors ${index} count)
+	string(JSON actualType GET "${json}" accessors ${index} type)
+	string(JSON actualComponent GET "${json}" accessors ${index} componentType)
+	string(JSON view GET "${json}" accessors ${index} bufferView)
+	string(JSON viewLength GET "${json}" bufferViews ${view} byteLength)
+	math(EXPR expectedLength "${count} * ${size}")
+
+	if(NOT actualCount EQUAL count OR NOT actualType STREQUAL type OR NOT actualComponent EQUAL component OR NOT viewLength EQUAL expectedLength)
+		message(FATAL_ERROR "${path}: accessor ${index} has ${actualCount} ${actualType} of ${actualComponent} in ${viewLength} bytes, expected ${count} ${type} of ${component} in ${expectedLength}")
+	endif()
+endfunction()
+
+function(check_gltf path)
+	file(READ ${path} json)
+
+	string(JSON version GET "${json}" asset version)
+	if(NOT version STREQUAL "2.0")
+		message(FATAL_ERROR "${path}: glTF version ${version}")
+	endif()
+
+	# One embedded buffer, holding every view
+	string(JSON bufferLength GET "${json}" buffers 0 byteLength)
+	string(JSON uri GET "${json}" buffers 0 uri)
+	set (prefix "data:application/octet-stream;base64,")
+	string(LENGTH "${prefix}" prefixLength)
+	string(LENGTH "${uri}" uriLength)
+	string(FIND "${uri}" "${prefix}" found)
+	math(EXPR encodedLength "${uriLength} - ${prefixLength}")
+	math(EXPR expectedLength "(${bufferLength} + 2) / 3 * 4")
+	if(NOT found EQUAL 0 OR NOT encodedLength EQUAL expectedLength)
+		message(FATAL_ERROR "${path}: the buffer is not ${bufferLength} bytes of embedded base64")
+	endif()
+
+	string(JSON viewCount LENGTH "${json}" bufferViews)
+	math(EXPR last "${viewCount} - 1")
+	foreach(view RANGE ${last})
+		string(JSON offset GET "${json}" bufferViews ${view} byteOffset)
+		string(JSON length GET "${json}" bufferViews ${view} byteLength)
+		math(EXPR end "${offset} + ${length}")
+		if(end GREATER bufferLength)
+			message(FATAL_ERROR "${path}: bufferView ${view} ends past the buffer")
+		endif()
+	endforeach()
+
+	string(JSON meshCount LENGTH "${json}" meshes)
+	math(EXPR last "${meshCount} - 1")
+	foreach(mesh RANGE ${last})
+		string(JSON position GET "${json}" meshes ${mesh} primitives 0 attributes POSITION)
+		string(JSON uv GET "${json}" meshes ${mesh} primitives 0 attributes TEXCOORD_0)
+		string(JSON normal GET "${json}" meshes ${mesh} primitives 0 attributes NORMAL)
+		string(JSON indices GET "${json}" meshes ${mesh} primitives 0 indices)
+		string(JSON count GET "${json}" accessors ${position} count)
+		string(JSON indexCount GET "${json}" accessors ${indices} count)
+
+		check_accessor(${path} "${json}" ${position} ${count} VEC3 5126 12)
+		check_accessor(${path} "${json}" ${uv} ${count} VEC2 5126 8)
+		check_accessor(${path} "${json}" ${normal} ${count} VEC3 5126 12)
+		check_accessor(${path} "${json}" ${indices} ${indexCount} SCALAR 5125 4)
+
+		math(EXPR remainder "${indexCount} % 3")
+		if(NOT remainder EQUAL 0)
+			message(FATAL_ERROR "${path}: ${indexCount} indices are not whole triangles")
+		endif()
+
+		foreach(bound min max)
+			foreach(axis 0 1 2)
+				string(JSON value GET "${json}" accessors ${position} ${bound} ${axis})
+				if(NOT value MATCHES "${ON_GRID}")
+					message(FATAL_ERROR "${path}: the position ${bound} ${value} is not on the quantization grid")
+				endif()
+			endforeach()
+		endforeach()
+	endforeach()
+endfunction()
+
+convert(${WORK}/export-whole)
+convert(${WORK}/export-streamed --stream 0.1)
+
+execute_process(COMMAND ${CONVERT} --validate ${WORK}/export-whole ${WORK}/export-streamed RESULT_VARIABLE result OUTPUT_VARIABLE text)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "The streamed models differ from those read whole:\n${text}")
+endif()
+
+file(GLOB objFiles ${WORK}/export-streamed/*.obj)
+file(GLOB gltfFiles ${WORK}/export-streamed/*.gltf)
+list(LENGTH FILES fileCount)
+list(LENGTH objFiles objCount)
+list(LENGTH gltfFiles gltfCount)
+if(NOT objCount EQUAL fileCount OR NOT gltfCount EQUAL fileCount)
+	message(FATAL_ERROR "Expected an OBJ and a glTF file for each of the ${fileCount} files")
+endif()
+
+foreach(path ${objFiles})
+	check_obj(${path})
+endforeach()
+
+foreach(path ${gltfFiles})
+	check_gltf(${path})
+endforeach()
+
+message("Export checks passed")
@@ -0,0 +1,70 @@
+# Checks the .blendidx block index on a copy of FILE in WORK: listings answered from the
+# index match those of the full parse, and the index is ignored once the file is touched
+# or replaced by OTHER. An index is in use when no input is read, as --memory-report
+# shows.
+#
+#   cmake -DCONVERT=blender-convert -DFILE=cube.blend -DOTHER=monkey.blend -DWORK=dir -P index_test.cmake
+
+set (COPY ${WORK}/index-test.blend)
+set (COMMANDS --list-header --list-blocks --list-structs)
+
+function(convert output)
+	execute_process(COMMAND ${CONVERT} ${ARGN} RESULT_VARIABLE result OUTPUT_VARIABLE text)
+
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "blender-convert ${ARGN} failed:\n${text}")
+	endif()
+
+	set(${output} "${text}" PARENT_SCOPE)
+endfunction()
+
+# Fails unless the listings of path match expected_<command>, and the file was read, or
+# not, as read says
+function(check path read expected_prefix)
+	foreach(command ${COMMANDS})
+		convert(listing ${path} ${command})
+
+		if(NOT "${listing}" STREQUAL "${${expected_prefix}${command}}")
+			message(FATAL_ERROR "${command} differs from the full parse of the file")
+		endif()
+	endforeach()
+
+	convert(report ${path} --list-blocks --memory-report)
+	string(FIND "${report}" "Input: 0.00 MB" unread)
+
+	if(read AND NOT unread EQUAL -1)
+		message(FATAL_ERROR "A stale block index was used")
+	elseif(NOT read AND unread EQUAL -1)
+		message(FATAL_ERROR "The block index was not used")
+	endif()
+endfunction()
+
+foreach(command ${COMMANDS})
+	convert(plain${command} ${FILE} ${command})
+	convert(other${command} ${OTHER} ${command})
+endforeach()
+
+file(REMOVE ${COPY} ${WORK}/index-test.blendidx)
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy ${FILE} ${COPY})
+
+check(${COPY} TRUE plain)
+
+convert(built ${COPY} --build-index)
+if(NOT EXISTS ${WORK}/index-test.blendidx)
+	message(FATAL_ERROR "--build-index wrote no index:\n${built}")
+endif()
+
+check(${COPY} FALSE plain)
+
+# A new modification time alone makes the index stale, even within the second it was
+# built in
+convert(built ${COPY} --build-index)
+execute_process(COMMAND ${CMAKE_COMMAND} -E touch ${COPY})
+check(${COPY} TRUE plain)
+
+# And so does another file in its place
+convert(built ${COPY} --build-index)
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy ${OTHER} ${COPY})
+check(${COPY} TRUE other)
+
+message("Block index checks passed")
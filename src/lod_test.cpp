@@ -0,0 +1,89 @@
+#include "converter.h"
+
+// Simplifies the meshes of each file to every target triangle count and checks that each
+// level is at or under its target, and that its triangles are in range and not
+// degenerate: three different vertices at three different positions.
+
+static const std::vector<int> targets = { 800, 500, 300, 100, 40, 12 };
+
+static int failures = 0;
+
+static void fail(const std::string &model, int target, const char *format, int triangle){
+	char message[100];
+	sprintf(message, format, triangle);
+	printf("FAIL %s at %i triangles: %s\n", model.c_str(), target, message);
+	failures++;
+}
+
+static void check(const std::string &model, int target, ExtractedMesh *mesh){
+	int vertexCount = mesh->getVertexCount();
+	int loopCount = mesh->getLoopCount();
+	auto &positions = mesh->positions;
+
+	if(mesh->getTriangleCount() > target){
+		fail(model, target, "%i triangles are over the target", mesh->getTriangleCount());
+	}
+
+	for(int i = 0; i < mesh->getTriangleCount(); i++){
+		int vertices[3];
+
+		for(int corner = 0; corner < 3; corner++){
+			auto loop = mesh->triangles[i * 3 + corner];
+			if(loop < 0 || loop >= loopCount || mesh->loopVertices[loop] < 0 || mesh->loopVertices[loop] >= vertexCount){
+				fail(model, target, "triangle %i is out of range", i);
+				return;
+			}
+
+			vertices[corner] = mesh->loopVertices[loop];
+		}
+
+		for(int corner = 0; corner < 3; corner++){
+			auto a = vertices[corner];
+			auto b = vertices[(corner + 1) % 3];
+
+			if(a == b || memcmp(&positions[a * 3], &positions[b * 3], sizeof(float) * 3) == 0){
+				fail(model, target, "triangle %i is degenerate", i);
+				return;
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv){
+	if(argc < 2){
+		printf("Usage: lod_test [files...]\n");
+		return 2;
+	}
+
+	for(int i = 1; i < argc; i++){
+		try {
+			BlendFile file(argv[i]);
+			ConvertOptions options;
+			options.verbose = false;
+			options.lodTriangleCounts = targets;
+
+			for(auto &model : extractModels(file, options)){
+				if(model.levels.size() != targets.size() + 1){
+					printf("FAIL %s: %i levels, expected %i\n", model.name.c_str(), (int)model.levels.size(), (int)targets.size() + 1);
+					failures++;
+					continue;
+				}
+
+				for(size_t level = 0; level < targets.size(); level++){
+					check(model.name, targets[level], model.levels[level + 1].get());
+				}
+			}
+		} catch(const std::exception &e) {
+			printf("FAIL %s: %s\n", argv[i], e.what());
+			failures++;
+		}
+	}
+
+	if(failures){
+		printf("%i checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,232 @@
+#include "converter.h"
+
+// Converts a copy of the default cube with modifiers added to it and checks the counts of
+// the welded mesh. The cube is moved to span x from 0 to 2, so one face lies on the
+// mirror plane, and is given a Mirror modifier on X with merging, followed by an Array of
+// three copies at a relative offset of 1 along X, merging neighbours.
+//
+// Mirror: 8 + 8 vertices, of which the 4 on the plane merge, and 6 + 6 quads -> 12, 48, 12
+// Array: 3 copies, of which neighbours share 4 vertices -> 3 * 12 - 2 * 4 = 28, 144, 36
+
+static int failures = 0;
+
+enum {
+	eModifierType_Mirror = 5,
+	eModifierType_Array = 12,
+	eModifierMode_Realtime = 1 << 0,
+	MOD_MIR_AXIS_X = 1 << 3,
+	MOD_ARR_OFF_RELATIVE = 1 << 1,
+	MOD_ARR_MERGE = 1 << 0
+};
+
+// A block of the file as Blender wrote it, found by walking the block headers
+class RawBlock {
+	public:
+	std::string code;
+	size_t offset; // of the header
+	size_t size; // of the body
+	unsigned long long address;
+};
+
+static std::vector<RawBlock> readBlocks(const std::string &contents){
+	const size_t headerSize = 24; // code, size, 64 bit address, SDNA index, count
+	std::vector<RawBlock> result;
+
+	if(contents.compare(0, 9, "BLENDER-v") != 0){
+		throw std::runtime_error("The fixture needs a little endian file with 64 bit pointers");
+	}
+
+	for(size_t offset = 12; offset + headerSize <= contents.size();){
+		RawBlock block;
+		int32_t size;
+
+		block.code = contents.substr(offset, 4);
+		block.offset = offset;
+		memcpy(&size, &contents[offset + 4], sizeof(size));
+		memcpy(&block.address, &contents[offset + 8], sizeof(block.address));
+		block.size = size;
+		result.push_back(block);
+
+		if(block.code == "ENDB"){
+			break;
+		}
+		offset += headerSize + block.size;
+	}
+
+	return result;
+}
+
+static RawBlock& findBlock(std::vector<RawBlock> &blocks, unsigned long long address){
+	for(auto &block : blocks){
+		if(block.address == address){
+			return block;
+		}
+	}
+
+	throw std::runtime_error("Could not find the block of an address");
+}
+
+// Writes value to the field at path of a struct of type at body
+template<typename T>
+static void set(BlendType *type, char *body, const std::string &path, T value){
+	auto location = type->locate(path);
+
+	if(location.length != sizeof(T)){
+		throw std::runtime_error(std::string("Unexpected size of ") + path + " on " + type->name);
+	}
+
+	memcpy(body + location.offset, &value, sizeof(T));
+}
+
+static int getStructIndex(BlendFile &file, const std::string &name){
+	int index = 0;
+	for(auto &sdnaStruct : *file.data->sdna_structs()){
+		if(sdnaStruct->type() == name){
+			return index;
+		}
+		index++;
+	}
+
+	throw std::runtime_error(std::string("Could not find struct ") + name);
+}
+
+static std::string makeBlock(int structIndex, unsigned long long address, const std::string &body){
+	std::string result("DATA", 4);
+	int32_t size = body.size();
+	int32_t count = 1;
+
+	result.append((const char*)&size, sizeof(size));
+	result.append((const char*)&address, sizeof(address));
+	result.append((const char*)&structIndex, sizeof(structIndex));
+	result.append((const char*)&count, sizeof(count));
+
+	return result + body;
+}
+
+// The contents of cube.blend with the cube moved and its modifiers added
+static std::string makeFixture(std::string path){
+	std::string contents;
+	if(!readFile(path, contents)){
+		throw std::runtime_error(std::string("Could not read ") + path);
+	}
+
+	BlendFile file(path, contents);
+	auto &types = *file.typeProvider;
+	auto blocks = readBlocks(contents);
+
+	DataBlock *cube = nullptr;
+	for(auto object : file.blockProvider->getBlocks("OB")){
+		if(std::string(object->getPart().getString("id.name").c_str()) == "OBCube"){
+			cube = object;
+		}
+	}
+	if(cube == nullptr){
+		throw std::runtime_error("Could not find the cube");
+	}
+
+	// Move the cube along X, so its face at x = -1 lies on the mirror plane
+	auto mesh = file.blockProvider->getBlock(cube->getPart().getPointer("*data"))->getPart();
+	auto vertices = findBlock(blocks, mesh.getPointer("*mvert"));
+	auto vertexType = types.getType("MVert");
+	auto x = vertexType->getOffset("co[0]");
+	for(int i = 0; i < mesh.getInt("totvert"); i++){
+		float value;
+		auto position = &contents[vertices.offset + 24 + i * vertexType->size + x];
+		memcpy(&value, position, sizeof(value));
+		value += 1;
+		memcpy(position, &value, sizeof(value));
+	}
+
+	unsigned long long mirrorAddress = 0;
+	for(auto &block : blocks){
+		mirrorAddress = std::max(mirrorAddress, block.address + block.size);
+	}
+	mirrorAddress += 0x1000;
+	auto arrayAddress = mirrorAddress + 0x1000;
+
+	auto mirrorType = types.getType("MirrorModifierData");
+	std::string mirror(mirrorType->size, '\0');
+	set<unsigned long long>(mirrorType, &mirror[0], "modifier.*next", arrayAddress);
+	set<int32_t>(mirrorType, &mirror[0], "modifier.type", eModifierType_Mirror);
+	set<int32_t>(mirrorType, &mirror[0], "modifier.mode", eModifierMode_Realtime);
+	strcpy(&mirror[mirrorType->getOffset("modifier.name")], "Mirror");
+	set<int16_t>(mirrorType, &mirror[0], "flag", MOD_MIR_AXIS_X);
+	set<float>(mirrorType, &mirror[0], "tolerance", 0.001f);
+
+	auto arrayType = types.getType("ArrayModifierData");
+	std::string array(arrayType->size, '\0');
+	set<unsigned long long>(arrayType, &array[0], "modifier.*prev", mirrorAddress);
+	set<int32_t>(arrayType, &array[0], "modifier.type", eModifierType_Array);
+	set<int32_t>(arrayType, &array[0], "modifier.mode", eModifierMode_Realtime);
+	strcpy(&array[arrayType->getOffset("modifier.name")], "Array");
+	set<int32_t>(arrayType, &array[0], "count", 3);
+	set<int32_t>(arrayType, &array[0], "offset_type", MOD_ARR_OFF_RELATIVE);
+	set<float>(arrayType, &array[0], "scale[0]", 1);
+	set<int32_t>(arrayType, &array[0], "flags", MOD_ARR_MERGE);
+	set<float>(arrayType, &array[0], "merge_dist", 0.01f);
+
+	auto objectType = types.getType("Object");
+	auto object = &contents[findBlock(blocks, cube->memaddr).offset + 24];
+	set<unsigned long long>(objectType, object, "modifiers.*first", mirrorAddress);
+	set<unsigned long long>(objectType, object, "modifiers.*last", arrayAddress);
+
+	// New blocks go before DNA1, which the parser expects right before ENDB
+	for(auto &block : blocks){
+		if(block.code == "DNA1"){
+			contents.insert(block.offset, makeBlock(getStructIndex(file, "MirrorModifierData"), mirrorAddress, mirror) + makeBlock(getStructIndex(file, "ArrayModifierData"), arrayAddress, array));
+			return contents;
+		}
+	}
+
+	throw std::runtime_error("Could not find DNA1");
+}
+
+static void check(const std::string &contents, bool modifiers, int vertexCount, int loopCount, int polyCount){
+	BlendFile file("modifiers.blend", contents);
+	ConvertOptions options;
+	options.verbose = false;
+	options.modifiers = modifiers;
+
+	auto models = extractModels(file, options);
+	if(models.size() != 1){
+		printf("FAIL %i models, expected 1\n", (int)models.size());
+		failures++;
+		return;
+	}
+
+	auto mesh = models[0].levels[0].get();
+	if(mesh->getVertexCount() != vertexCount || mesh->getLoopCount() != loopCount || mesh->getPolyCount() != polyCount){
+		printf("FAIL %s modifiers: %i vertices, %i loops, %i polygons, expected %i, %i, %i\n", modifiers ? "with" : "without",
+			mesh->getVertexCount(), mesh->getLoopCount(), mesh->getPolyCount(), vertexCount, loopCount, polyCount);
+		failures++;
+	}
+	if(mesh->getTriangleCount() != polyCount * 2){
+		printf("FAIL %s modifiers: %i triangles, expected %i\n", modifiers ? "with" : "without", mesh->getTriangleCount(), polyCount * 2);
+		failures++;
+	}
+}
+
+int main(int argc, char **argv){
+	if(argc != 2){
+		printf("Usage: modifier_test [cube.blend]\n");
+		return 2;
+	}
+
+	try {
+		auto fixture = makeFixture(argv[1]);
+
+		check(fixture, true, 28, 144, 36);
+		check(fixture, false, 8, 24, 6);
+	} catch(const std::exception &e) {
+		printf("FAIL %s\n", e.what());
+		failures++;
+	}
+
+	if(failures){
+		printf("%i checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
@@ -1,486 +1,1725 @@
-#include <stdio.h>
-#include <fstream>
-#include <kaitai/kaitaistream.h>
-#include "blender_blend.h"
-#include <map>
-#include <algorithm>
-
-// References:
-//   https://formats.kaitai.io/blender_blend/index.html
-//   http://homac.cakelab.org/projects/JavaBlend/spec.html
-//   https://developer.blender.org/diffusion/B/browse/master/doc/blender_file_format/BlendFileReader.py
-//   https://fossies.org/linux/blender/doc/blender_file_format/mystery_of_the_blend.html
-//   https://archive.blender.org/wiki/index.php/Dev:Source/Architecture/File_Format/#Structure_DNA
-//   https://wiki.blender.org/wiki/Source/Architecture/RNA
-
-unsigned long long readPointer(const char* data, int pointerSize) {
-	unsigned long long int value = 0;
-
-	auto small = static_cast<unsigned long int>(
-		static_cast<unsigned char>(data[0]) << 24 |
-		static_cast<unsigned char>(data[1]) << 16 | 
-		static_cast<unsigned char>(data[2]) << 8  | 
-		static_cast<unsigned char>(data[3])
-	);
-
-	value = small;
-
-	if(pointerSize == 8){
-		auto big = static_cast<unsigned long int>(
-			static_cast<unsigned char>(data[4]) << 24 |
-			static_cast<unsigned char>(data[5]) << 16 | 
-			static_cast<unsigned char>(data[6]) << 8  | 
-			static_cast<unsigned char>(data[7])
-		);
-
-		value = big << 32 | value;
-	}
-
-	return value;
+#include "converter.h"
+#include <condition_variable>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <strings.h>
+
+// Replaced here rather than in libblendconvert, so embedding the library never changes
+// the allocator of the program it is linked into
+#ifdef TRACK_MEMORY
+void* operator new(size_t size){
+	auto header = (MemoryTracker::Header*)malloc(sizeof(MemoryTracker::Header) + size);
+
+	if(header == nullptr){
+		throw std::bad_alloc();
+	}
+
+	header->size = size;
+	header->subsystem = MemoryTracker::current;
+	MemoryTracker::allocated(header->subsystem, size);
+
+	return header + 1;
+}
+
+void operator delete(void *pointer) noexcept {
+	if(pointer == nullptr){
+		return;
+	}
+
+	auto header = (MemoryTracker::Header*)pointer - 1;
+	MemoryTracker::freed(header->subsystem, header->size);
+	free(header);
+}
+
+void* operator new[](size_t size){
+	return operator new(size);
+}
+
+void operator delete[](void *pointer) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete(void *pointer, size_t size) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t size) noexcept {
+	operator delete(pointer);
+}
+#endif
+
+// A file mapped read-only into memory for the lifetime of the object
+class MappedFile {
+	private:
+	void *address;
+
+	public:
+	const char *data;
+	size_t size;
+	MappedFile(std::string path){
+		address = nullptr;
+		data = nullptr;
+		size = 0;
+
+		int file = open(path.c_str(), O_RDONLY);
+		if(file < 0){
+			throw std::runtime_error(std::string("Could not open ") + path);
+		}
+
+		struct stat status;
+		if(fstat(file, &status) != 0){
+			status.st_size = 0;
+		}
+		if(status.st_size > 0){
+			address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if(address == MAP_FAILED){
+				address = nullptr;
+			} else {
+				data = (const char*)address;
+				size = status.st_size;
+			}
+		}
+		close(file);
+
+		if(address == nullptr && status.st_size > 0){
+			throw std::runtime_error(std::string("Could not map ") + path);
+		}
+	}
+	~MappedFile(){
+		if(address != nullptr){
+			munmap(address, size);
+		}
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+};
+
+class PieLevel {
+	public:
+	std::vector<float> points; // x, y, z per point
+	std::vector<int> polygonStarts; // into indices, one per polygon
+	std::vector<int> polygonCounts;
+	std::vector<int> indices; // point index per polygon corner
+	std::vector<float> uvs; // u, v per polygon corner, from 0 to 1
+	std::vector<float> normals; // x, y, z per polygon corner, PIE 4 only
+	std::vector<float> connectors; // x, y, z per connector
+	int animationFrames = 0;
+};
+
+class PieModel {
+	public:
+	int version = 0;
+	int type = 0;
+	std::string texture;
+	std::vector<PieLevel> levels;
+};
+
+// Reads PIE 2, 3 and 4 models straight out of the mapped file, with hand-rolled number
+// parsing that needs neither line copies nor the C locale. PIE 2 texture coordinates are
+// in texels and are scaled to 0..1 by the texture size, as PIE 3 stores them.
+class PieReader {
+	private:
+	std::string path;
+	const char *position;
+	const char *end;
+	int line;
+
+	enum {
+		iV_IMD_TEXANIM = 0x4000
+	};
+
+	void fail(const std::string &message){
+		throw std::runtime_error(path + ":" + std::to_string(line) + ": " + message);
+	}
+
+	void skipSpaces(){
+		while(position < end && (*position == ' ' || *position == '\t' || *position == '\r')){
+			position++;
+		}
+	}
+
+	// Moves to the start of the next line that is not empty
+	void nextLine(){
+		while(position < end && *position != '\n'){
+			position++;
+		}
+		while(position < end && (*position == '\n' || *position == '\r' || *position == ' ' || *position == '\t')){
+			line += *position == '\n';
+			position++;
+		}
+	}
+
+	bool atLineEnd(){
+		skipSpaces();
+		return position >= end || *position == '\n';
+	}
+
+	std::string readWord(){
+		skipSpaces();
+		auto start = position;
+		while(position < end && *position != ' ' && *position != '\t' && *position != '\r' && *position != '\n'){
+			position++;
+		}
+		if(start == position){
+			fail("expected a word");
+		}
+		return std::string(start, position);
+	}
+
+	long long readInt(int base = 10){
+		skipSpaces();
+		bool negative = position < end && *position == '-';
+		if(position < end && (*position == '-' || *position == '+')){
+			position++;
+		}
+
+		auto start = position;
+		long long value = 0;
+		while(position < end){
+			int digit;
+			if(*position >= '0' && *position <= '9'){
+				digit = *position - '0';
+			} else if(base == 16 && (*position | 0x20) >= 'a' && (*position | 0x20) <= 'f'){
+				digit = (*position | 0x20) - 'a' + 10;
+			} else {
+				break;
+			}
+			value = value * base + digit;
+			position++;
+		}
+
+		if(start == position){
+			fail("expected a number");
+		}
+		return negative ? -value : value;
+	}
+
+	float readFloat(){
+		static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+		skipSpaces();
+		bool negative = position < end && *position == '-';
+		if(position < end && (*position == '-' || *position == '+')){
+			position++;
+		}
+
+		auto start = position;
+		unsigned long long mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+
+		for(; position < end && *position >= '0' && *position <= '9'; position++){
+			if(digits < 18){
+				mantissa = mantissa * 10 + (*position - '0');
+				digits += mantissa != 0;
+			} else {
+				exponent++;
+			}
+		}
+		if(position < end && *position == '.'){
+			for(position++; position < end && *position >= '0' && *position <= '9'; position++){
+				if(digits < 18){
+					mantissa = mantissa * 10 + (*position - '0');
+					digits += mantissa != 0;
+					exponent--;
+				}
+			}
+		}
+		if(start == position){
+			fail("expected a number");
+		}
+		if(position < end && (*position | 0x20) == 'e'){
+			position++;
+			exponent += readInt();
+		}
+
+		double value = mantissa;
+		while(exponent > 18){
+			value *= 1e18;
+			exponent -= 18;
+		}
+		while(exponent < -18){
+			value /= 1e18;
+			exponent += 18;
+		}
+		value = exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
+
+		return negative ? -value : value;
+	}
+
+	void readPolygons(PieLevel &level, int count, float textureWidth, float textureHeight, int version){
+		level.polygonStarts.reserve(count);
+		level.polygonCounts.reserve(count);
+
+		for(int i = 0; i < count; i++){
+			nextLine();
+			auto flags = readInt(16);
+			auto corners = readInt();
+
+			if(corners < 3){
+				fail("polygon with fewer than 3 points");
+			}
+
+			level.polygonStarts.push_back(level.indices.size());
+			level.polygonCounts.push_back(corners);
+
+			for(int j = 0; j < corners; j++){
+				auto index = readInt();
+				if(index < 0 || index >= (long long)level.points.size() / 3){
+					fail("point index out of range");
+				}
+				level.indices.push_back(index);
+			}
+
+			if(flags & iV_IMD_TEXANIM){
+				level.animationFrames = readInt();
+				readInt(); // playback rate
+				readFloat(); // frame width and height
+				readFloat();
+			}
+
+			for(int j = 0; j < corners; j++){
+				float u = readFloat();
+				float v = readFloat();
+
+				if(version < 3){
+					u /= textureWidth;
+					v /= textureHeight;
+				}
+				level.uvs.push_back(u);
+				level.uvs.push_back(v);
+			}
+		}
+	}
+
+	void readFloats(std::vector<float> &result, int lines, int perLine){
+		result.reserve(result.size() + lines * perLine);
+
+		for(int i = 0; i < lines; i++){
+			nextLine();
+			for(int j = 0; j < perLine; j++){
+				result.push_back(readFloat());
+			}
+		}
+	}
+
+	public:
+	PieReader(std::string path){
+		this->path = path;
+	}
+
+	PieModel read(){
+		MappedFile file(path);
+		PieModel result;
+		float textureWidth = 256;
+		float textureHeight = 256;
+
+		position = file.data;
+		end = file.data + file.size;
+		line = 1;
+
+		if(readWord() != "PIE"){
+			fail("not a PIE model");
+		}
+		result.version = readInt();
+		if(result.version < 2 || result.version > 4){
+			fail("unsupported PIE version " + std::to_string(result.version));
+		}
+
+		int levelCount = -1;
+
+		while(levelCount < 0){
+			nextLine();
+			if(position >= end){
+				fail("no LEVELS");
+			}
+
+			auto keyword = readWord();
+
+			if(keyword == "TYPE"){
+				result.type = readInt(16);
+			} else if(keyword == "TEXTURE"){
+				readInt();
+				result.texture = readWord();
+				if(!atLineEnd()){
+					auto width = readFloat();
+					auto height = readFloat();
+					if(width > 0 && height > 0){
+						textureWidth = width;
+						textureHeight = height;
+					}
+				}
+			} else if(keyword == "LEVELS"){
+				levelCount = readInt();
+			}
+			// NORMALMAP, SPECULARMAP, EVENT and other model-wide lines do not matter here
+		}
+
+		result.levels.resize(levelCount);
+		PieLevel *level = nullptr;
+
+		for(nextLine(); position < end; nextLine()){
+			auto keyword = readWord();
+
+			if(keyword == "LEVEL"){
+				auto index = readInt();
+				if(index < 1 || index > levelCount){
+					fail("level out of range");
+				}
+				level = &result.levels[index - 1];
+				continue;
+			}
+			if(level == nullptr){
+				fail("expected LEVEL");
+			}
+
+			if(keyword == "POINTS"){
+				readFloats(level->points, readInt(), 3);
+			} else if(keyword == "POLYGONS"){
+				readPolygons(*level, readInt(), textureWidth, textureHeight, result.version);
+			} else if(keyword == "NORMALS"){
+				readFloats(level->normals, readInt(), 9);
+			} else if(keyword == "CONNECTORS"){
+				readFloats(level->connectors, readInt(), 3);
+			} else if(keyword == "ANIMOBJECT"){
+				readInt();
+				readInt();
+				auto frames = readInt();
+				for(int i = 0; i < frames; i++){
+					nextLine();
+				}
+			} else if(keyword == "SHADOWPOINTS" || keyword == "SHADOWPOLYGONS"){
+				auto count = readInt();
+				for(int i = 0; i < count; i++){
+					nextLine();
+				}
+			}
+		}
+
+		return result;
+	}
 };
 
-class BlendField{
+// Compares models by their triangles, independent of point and polygon order: every
+// triangle of each model needs one in the other whose corners, in the same winding,
+// lie within tolerance in position and uvTolerance in texture space.
+class PieValidator {
+	private:
+	float tolerance;
+	float uvTolerance;
+
+	class Corner {
+		public:
+		float position[3];
+		float uv[2];
+	};
+
+	class Triangle {
+		public:
+		Corner corners[3];
+		float center[3];
+	};
+
+	static std::vector<Triangle> getTriangles(const PieLevel &level){
+		std::vector<Triangle> result;
+		result.reserve(level.indices.size());
+
+		for(size_t polygon = 0; polygon < level.polygonStarts.size(); polygon++){
+			auto start = level.polygonStarts[polygon];
+
+			for(int i = 1; i + 1 < level.polygonCounts[polygon]; i++){
+				Triangle triangle;
+				int corners[3] = { start, start + i, start + i + 1 };
+
+				for(int j = 0; j < 3; j++){
+					auto &corner = triangle.corners[j];
+					memcpy(corner.position, &level.points[level.indices[corners[j]] * 3], sizeof(corner.position));
+					memcpy(corner.uv, &level.uvs[corners[j] * 2], sizeof(corner.uv));
+				}
+				for(int j = 0; j < 3; j++){
+					triangle.center[j] = (triangle.corners[0].position[j] + triangle.corners[1].position[j] + triangle.corners[2].position[j]) / 3;
+				}
+
+				result.push_back(triangle);
+			}
+		}
+
+		return result;
+	}
+
+	bool matches(const Triangle &a, const Triangle &b){
+		for(int rotation = 0; rotation < 3; rotation++){
+			bool match = true;
+
+			for(int i = 0; i < 3 && match; i++){
+				auto &first = a.corners[i];
+				auto &second = b.corners[(i + rotation) % 3];
+
+				for(int j = 0; j < 3; j++){
+					match &= fabsf(first.position[j] - second.position[j]) <= tolerance;
+				}
+				for(int j = 0; j < 2; j++){
+					match &= fabsf(first.uv[j] - second.uv[j]) <= uvTolerance;
+				}
+			}
+
+			if(match){
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// The triangles of from that have no match in to. Candidates are the triangles of to
+	// whose centers lie within tolerance along x, found by binary search.
+	int countUnmatched(const std::vector<Triangle> &from, const std::vector<Triangle> &to){
+		std::vector<float> centers(to.size());
+		std::vector<int> order(to.size());
+
+		for(size_t i = 0; i < to.size(); i++){
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&to](int a, int b){
+			return to[a].center[0] < to[b].center[0];
+		});
+		for(size_t i = 0; i < to.size(); i++){
+			centers[i] = to[order[i]].center[0];
+		}
+
+		int result = 0;
+
+		for(auto &triangle : from){
+			bool found = false;
+			auto first = std::lower_bound(centers.begin(), centers.end(), triangle.center[0] - tolerance) - centers.begin();
+
+			for(size_t i = first; i < centers.size() && centers[i] <= triangle.center[0] + tolerance && !found; i++){
+				found = matches(triangle, to[order[i]]);
+			}
+
+			result += !found;
+		}
+
+		return result;
+	}
+
+	public:
+	PieValidator(float tolerance, float uvTolerance){
+		this->tolerance = tolerance;
+		this->uvTolerance = uvTolerance;
+	}
+
+	// An empty string when the models match, else what differs
+	std::string compare(const PieModel &reference, const PieModel &converted){
+		char data[200];
+
+		if(reference.levels.size() != converted.levels.size()){
+			sprintf(data, "%i levels, expected %i", (int)converted.levels.size(), (int)reference.levels.size());
+			return data;
+		}
+
+		for(size_t level = 0; level < reference.levels.size(); level++){
+			auto expected = getTriangles(reference.levels[level]);
+			auto actual = getTriangles(converted.levels[level]);
+			auto missing = countUnmatched(expected, actual);
+			auto extra = countUnmatched(actual, expected);
+
+			if(missing > 0 || extra > 0){
+				sprintf(data, "level %i: %i of %i triangles missing, %i of %i extra", (int)level + 1, missing, (int)expected.size(), extra, (int)actual.size());
+				return data;
+			}
+		}
+
+		return "";
+	}
+};
+
+// Buffers output to a FILE, so a dump is written in large chunks with bounded memory
+class BufferedWriter {
+	private:
+	FILE *file;
+	std::vector<char> buffer;
+	size_t used;
+
+	public:
+	BufferedWriter(FILE *file, size_t capacity = 1 << 16){
+		this->file = file;
+		this->buffer.resize(capacity);
+		this->used = 0;
+	}
+
+	~BufferedWriter(){
+		flush();
+	}
+
+	void write(const char *data, size_t length){
+		if(used + length > buffer.size()){
+			flush();
+
+			if(length > buffer.size()){
+				fwrite(data, 1, length, file);
+				return;
+			}
+		}
+
+		memcpy(&buffer[used], data, length);
+		used += length;
+	}
+
+	void write(const std::string &data){
+		write(data.data(), data.size());
+	}
+
+	void write(char c){
+		if(used == buffer.size()){
+			flush();
+		}
+
+		buffer[used++] = c;
+	}
+
+	void flush(){
+		if(used > 0){
+			fwrite(buffer.data(), 1, used, file);
+			used = 0;
+		}
+	}
+};
+
+// Receives the decoded contents of a file as a stream of events
+class DumpWriter {
+	public:
+	virtual ~DumpWriter(){}
+	virtual void beginFile(std::string version, int pointerSize) = 0;
+	virtual void endFile() = 0;
+	virtual void beginBlock(int index, std::string code, unsigned long long address, std::string type, int count) = 0;
+	virtual void endBlock() = 0;
+	virtual void beginObject() = 0;
+	virtual void endObject() = 0;
+	virtual void beginArray() = 0;
+	virtual void endArray() = 0;
+	virtual void key(const std::string &name) = 0;
+	virtual void integer(long long value) = 0;
+	virtual void unsignedInteger(unsigned long long value) = 0;
+	virtual void real(double value) = 0;
+	virtual void string(const char *value, size_t length) = 0;
+	virtual void pointer(int blockIndex, unsigned long long offset) = 0;
+	virtual void unresolvedPointer(unsigned long long address) = 0;
+	virtual void null() = 0;
+	virtual void raw(const char *data, size_t length) = 0;
+};
+
+class JsonDumpWriter : public DumpWriter {
+	private:
+	BufferedWriter *writer;
+	std::vector<bool> needsComma;
+	bool afterKey = false;
+
+	void separate(){
+		if(afterKey){
+			afterKey = false;
+			return;
+		}
+		if(!needsComma.empty()){
+			if(needsComma.back()){
+				writer->write(',');
+			}
+			needsComma.back() = true;
+		}
+	}
+
+	void open(char c){
+		separate();
+		writer->write(c);
+		needsComma.push_back(false);
+	}
+
+	void close(char c){
+		writer->write(c);
+		needsComma.pop_back();
+	}
+
+	void writeFormatted(const char *format, ...){
+		char text[64];
+		va_list arguments;
+		va_start(arguments, format);
+		auto length = vsnprintf(text, sizeof(text), format, arguments);
+		va_end(arguments);
+		writer->write(text, length);
+	}
+
+	// Length of the UTF-8 sequence at value, or 0 when it is not valid UTF-8
+	static size_t sequenceLength(const unsigned char *value, size_t remaining){
+		size_t length;
+		unsigned int codePoint;
+
+		if(value[0] >= 0xc2 && value[0] <= 0xdf){
+			length = 2;
+			codePoint = value[0] & 0x1f;
+		} else if(value[0] >= 0xe0 && value[0] <= 0xef){
+			length = 3;
+			codePoint = value[0] & 0x0f;
+		} else if(value[0] >= 0xf0 && value[0] <= 0xf4){
+			length = 4;
+			codePoint = value[0] & 0x07;
+		} else {
+			return 0;
+		}
+
+		if(length > remaining){
+			return 0;
+		}
+		for(size_t i = 1; i < length; i++){
+			if((value[i] & 0xc0) != 0x80){
+				return 0;
+			}
+			codePoint = (codePoint << 6) | (value[i] & 0x3f);
+		}
+
+		// overlong forms, surrogates and values past U+10FFFF
+		if((length == 3 && codePoint < 0x800) || (codePoint >= 0xd800 && codePoint <= 0xdfff) || (length == 4 && (codePoint < 0x10000 || codePoint > 0x10ffff))){
+			return 0;
+		}
+
+		return length;
+	}
+
+	// Names are UTF-8 in Blender and pass through; control characters and bytes that
+	// are not valid UTF-8 are escaped, the latter as the Latin-1 character of the byte
+	void quoted(const char *value, size_t length){
+		writer->write('"');
+		for(size_t i = 0; i < length; i++){
+			auto c = static_cast<unsigned char>(value[i]);
+
+			if(c == '"' || c == '\\'){
+				writer->write('\\');
+				writer->write((char)c);
+			} else if(c < 0x20 || c == 0x7f){
+				writeFormatted("\\u%04x", c);
+			} else if(c < 0x80){
+				writer->write((char)c);
+			} else {
+				auto sequence = sequenceLength(reinterpret_cast<const unsigned char*>(value + i), length - i);
+
+				if(sequence == 0){
+					writeFormatted("\\u%04x", c);
+				} else {
+					writer->write(value + i, sequence);
+					i += sequence - 1;
+				}
+			}
+		}
+		writer->write('"');
+	}
+
+	public:
+	JsonDumpWriter(BufferedWriter *writer){
+		this->writer = writer;
+	}
+
+	void beginFile(std::string version, int pointerSize){
+		open('{');
+		key("version");
+		string(version.data(), version.size());
+		key("pointerSize");
+		integer(pointerSize);
+		key("blocks");
+		open('[');
+	}
+	void endFile(){
+		close(']');
+		close('}');
+		writer->write('\n');
+	}
+	void beginBlock(int index, std::string code, unsigned long long address, std::string type, int count){
+		open('{');
+		key("index");
+		integer(index);
+		key("code");
+		string(code.c_str(), strlen(code.c_str()));
+		key("address");
+		separate();
+		writeFormatted("\"0x%llx\"", address);
+		key("type");
+		string(type.data(), type.size());
+		key("count");
+		integer(count);
+		key("data");
+	}
+	void endBlock(){
+		close('}');
+		writer->write('\n');
+	}
+	void beginObject(){
+		open('{');
+	}
+	void endObject(){
+		close('}');
+	}
+	void beginArray(){
+		open('[');
+	}
+	void endArray(){
+		close(']');
+	}
+	void key(const std::string &name){
+		separate();
+		quoted(name.data(), name.size());
+		writer->write(':');
+		afterKey = true;
+	}
+	void integer(long long value){
+		separate();
+		writeFormatted("%lld", value);
+	}
+	void unsignedInteger(unsigned long long value){
+		separate();
+		writeFormatted("%llu", value);
+	}
+	void real(double value){
+		separate();
+		if(std::isfinite(value)){
+			writeFormatted("%.9g", value);
+		} else {
+			writer->write("null");
+		}
+	}
+	void string(const char *value, size_t length){
+		separate();
+		quoted(value, length);
+	}
+	void pointer(int blockIndex, unsigned long long offset){
+		separate();
+		writeFormatted("{\"block\":%i,\"offset\":%llu}", blockIndex, offset);
+	}
+	void unresolvedPointer(unsigned long long address){
+		separate();
+		writeFormatted("{\"unresolved\":\"0x%llx\"}", address);
+	}
+	void null(){
+		separate();
+		writer->write("null");
+	}
+	void raw(const char *data, size_t length){
+		static const char digits[] = "0123456789abcdef";
+
+		separate();
+		writer->write('"');
+		for(size_t i = 0; i < length; i++){
+			auto c = static_cast<unsigned char>(data[i]);
+			writer->write(digits[c >> 4]);
+			writer->write(digits[c & 15]);
+		}
+		writer->write('"');
+	}
+};
+
+// Compact binary form of the same events: a one byte tag per event followed by its
+// payload. Integers and lengths are LEB128 varints (zigzag for signed values), and each
+// key is written out once, then referred to by its number.
+class BinaryDumpWriter : public DumpWriter {
+	private:
+	BufferedWriter *writer;
+	std::unordered_map<std::string, unsigned int> keys;
+
+	template<typename T>
+	void value(T value){
+		writer->write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void varint(unsigned long long value){
+		while(value >= 0x80){
+			writer->write((char)(value | 0x80));
+			value >>= 7;
+		}
+		writer->write((char)value);
+	}
+
+	void text(const char *value, size_t length){
+		varint(length);
+		writer->write(value, length);
+	}
+
+	public:
+	BinaryDumpWriter(BufferedWriter *writer){
+		this->writer = writer;
+	}
+
+	void beginFile(std::string version, int pointerSize){
+		writer->write("BLENDDUMP1", 10);
+		text(version.data(), version.size());
+		value<uint8_t>(pointerSize);
+	}
+	void endFile(){
+		writer->write('E');
+	}
+	void beginBlock(int index, std::string code, unsigned long long address, std::string type, int count){
+		writer->write('B');
+		varint(index);
+		writer->write(code.data(), 4);
+		value<uint64_t>(address);
+		text(type.data(), type.size());
+		varint(count);
+	}
+	void endBlock(){
+		writer->write('b');
+	}
+	void beginObject(){
+		writer->write('{');
+	}
+	void endObject(){
+		writer->write('}');
+	}
+	void beginArray(){
+		writer->write('[');
+	}
+	void endArray(){
+		writer->write(']');
+	}
+	void key(const std::string &name){
+		auto existing = keys.find(name);
+
+		if(existing != keys.end()){
+			writer->write('k');
+			varint(existing->second);
+			return;
+		}
+
+		auto id = keys.size();
+		keys[name] = id;
+		writer->write('K');
+		text(name.data(), name.size());
+	}
+	void integer(long long value){
+		writer->write('i');
+		varint(((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+	}
+	void unsignedInteger(unsigned long long value){
+		writer->write('I');
+		varint(value);
+	}
+	void real(double value){
+		float single = (float)value;
+
+		if(single == value){
+			writer->write('f');
+			this->value<float>(single);
+		} else {
+			writer->write('d');
+			this->value<double>(value);
+		}
+	}
+	void string(const char *value, size_t length){
+		writer->write('s');
+		text(value, length);
+	}
+	void pointer(int blockIndex, unsigned long long offset){
+		writer->write('p');
+		varint(blockIndex);
+		varint(offset);
+	}
+	void unresolvedPointer(unsigned long long address){
+		writer->write('u');
+		value<uint64_t>(address);
+	}
+	void null(){
+		writer->write('n');
+	}
+	void raw(const char *data, size_t length){
+		writer->write('x');
+		text(data, length);
+	}
+};
+
+// Decodes every block through its SDNA type and streams the result to a DumpWriter
+class FileDumper {
+	private:
+	TypeProvider *typeProvider;
+	BlockProvider *blockProvider;
+	DumpWriter *writer;
+
+	void dumpPointer(const char *data){
+		auto address = readPointer(data, typeProvider->pointerSize);
+
+		if(address == 0){
+			writer->null();
+			return;
+		}
+
+		auto block = blockProvider->findBlock(address);
+
+		if(block == nullptr){
+			writer->unresolvedPointer(address);
+			return;
+		}
+
+		writer->pointer(block->index, address - block->memaddr);
+	}
+
+	void dumpValue(const std::string &type, const char *data){
+		if(type == "char" || type == "int8_t"){
+			writer->integer(*reinterpret_cast<const int8_t*>(data));
+		} else if(type == "uchar" || type == "uint8_t"){
+			writer->integer(*reinterpret_cast<const uint8_t*>(data));
+		} else if(type == "short" || type == "int16_t"){
+			int16_t value;
+			memcpy(&value, data, sizeof(value));
+			writer->integer(value);
+		} else if(type == "ushort" || type == "uint16_t"){
+			uint16_t value;
+			memcpy(&value, data, sizeof(value));
+			writer->integer(value);
+		} else if(type == "int" || type == "long" || type == "int32_t"){
+			int32_t value;
+			memcpy(&value, data, sizeof(value));
+			writer->integer(value);
+		} else if(type == "ulong" || type == "uint32_t"){
+			uint32_t value;
+			memcpy(&value, data, sizeof(value));
+			writer->integer(value);
+		} else if(type == "int64_t"){
+			int64_t value;
+			memcpy(&value, data, sizeof(value));
+			writer->integer(value);
+		} else if(type == "uint64_t"){
+			uint64_t value;
+			memcpy(&value, data, sizeof(value));
+			writer->unsignedInteger(value);
+		} else if(type == "float"){
+			float value;
+			memcpy(&value, data, sizeof(value));
+			writer->real(value);
+		} else if(type == "double"){
+			double value;
+			memcpy(&value, data, sizeof(value));
+			writer->real(value);
+		} else {
+			dumpStruct(typeProvider->getType(type), data);
+		}
+	}
+
+	// Writes dimensions[dimension...] of a field as nested arrays
+	void dumpArray(BlendField *field, size_t dimension, int elementSize, const char *data){
+		if(dimension == field->dimensions.size()){
+			if(field->name[0] == '*' || field->name[0] == '('){
+				dumpPointer(data);
+			} else {
+				dumpValue(field->type, data);
+			}
+			return;
+		}
+
+		int stride = elementSize;
+		for(size_t i = dimension + 1; i < field->dimensions.size(); i++){
+			stride *= field->dimensions[i];
+		}
+
+		// the innermost dimension of a char array is text
+		if(dimension + 1 == field->dimensions.size() && field->type == "char" && field->name[0] != '*'){
+			auto length = strnlen(data, field->dimensions[dimension]);
+			writer->string(data, length);
+			return;
+		}
+
+		writer->beginArray();
+		for(int i = 0; i < field->dimensions[dimension]; i++){
+			dumpArray(field, dimension + 1, elementSize, data + i * stride);
+		}
+		writer->endArray();
+	}
+
+	void dumpStruct(BlendType *type, const char *data){
+		writer->beginObject();
+		for(auto field : type->getFields()){
+			writer->key(field->name);
+			dumpArray(field, 0, field->size / field->arraySize, data + field->offset);
+		}
+		writer->endObject();
+	}
+
 	public:
-	std::string name;
-	std::string type;
-	int size;
-	int offset;
-	int arraySize = -1;
-	BlendField(std::string name, std::string type, int size, int offset, int arraySize){
-		this->name = name;
-		this->type = type;
-		this->size = size;
-		this->offset = offset;
-		this->arraySize = arraySize;
+	FileDumper(TypeProvider *typeProvider, BlockProvider *blockProvider, DumpWriter *writer){
+		this->typeProvider = typeProvider;
+		this->blockProvider = blockProvider;
+		this->writer = writer;
 	}
-};
 
-class BlendType {
-	private:
-	std::vector<std::unique_ptr<BlendField>> fields;
-	std::map<std::string, BlendField*> fieldsByName;
+	void dump(std::string version){
+		writer->beginFile(version, typeProvider->pointerSize);
 
-	public:
-	std::string name;
-	int size;
-	BlendType(std::string name, int size, std::vector<BlendField*> fields){
-		this->name = name;
-		this->size = size;
+		for(auto block : blockProvider->getBlocks()){
+			auto type = block->part.type;
+			auto data = block->dataSource->getData();
+			auto size = block->dataSource->getSize();
+			auto isRaw = block->code == "DNA1" || type->size == 0 || (size_t)type->size * block->count != size;
 
-		for(auto field : fields){
-			this->fields.push_back(std::unique_ptr<BlendField>(field));
+			writer->beginBlock(block->index, block->code, block->memaddr, isRaw ? std::string("") : type->name, block->count);
+
+			if(isRaw){
+				writer->raw(data, size); // untyped data and the schema itself
+			} else {
+				writer->beginArray();
+				for(unsigned int i = 0; i < block->count; i++){
+					dumpStruct(type, data + i * type->size);
+				}
+				writer->endArray();
+			}
 
-			this->fieldsByName[field->name] = field;
+			writer->endBlock();
 		}
+
+		writer->endFile();
 	}
+};
 
-	std::vector<BlendField*> getFields(){
-		std::vector<BlendField*> result;
-		for(auto &field : fields){
-			result.push_back(&*field);
-		}
-		return result;
+class ReadAheadFile {
+	public:
+	std::string path;
+	std::string contents;
+	std::string error;
+	size_t reservedBytes;
+	ReadAheadFile(std::string path){
+		this->path = path;
+		this->reservedBytes = 0;
 	}
+};
 
-	BlendField* getField(std::string name){
-		if(!fieldsByName.count(name)){
-			throw std::runtime_error(std::string("Could not find field ") + name + " on type " + this->name);
+// Reads the next files of a batch on worker threads while the current one is being
+// converted. At most `depth` files are read ahead, and their combined size is kept
+// below `memoryBudget` (a single file larger than the budget is still let through once
+// nothing else is held, so the batch can't deadlock).
+class ReadAhead {
+	private:
+	std::vector<std::string> paths;
+	unsigned int depth;
+	size_t memoryBudget;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::map<size_t, std::unique_ptr<ReadAheadFile>> ready;
+	std::vector<std::thread> workers;
+	size_t nextToRead = 0;
+	size_t nextToTake = 0;
+	size_t bytesReserved = 0;
+	size_t bytesHandedOut = 0;
+	bool stopping = false;
+
+	static size_t getFileSize(std::string path){
+		std::ifstream is(path, std::ifstream::binary | std::ifstream::ate);
+
+		if(!is){
+			return 0;
 		}
 
-		return fieldsByName.at(name);
+		return (size_t)is.tellg();
 	}
-};
 
-class TypeProvider {
-	private:
-	blender_blend_t::dna1_body_t *dna;
-	std::map<std::string, BlendType*> typesByName;
-	std::map<int, std::string> typesBySdnaIndex;
-	std::map<std::string, int> sdnaIndexesByType;
-	std::map<std::string, int> typeLengths;
+	static void readFile(ReadAheadFile *file){
+		if(!::readFile(file->path, file->contents)){
+			file->error = std::string("Could not read file ") + file->path;
+		}
+	}
 
-	public:
-	int pointerSize;
-	TypeProvider(blender_blend_t &data){
-		pointerSize = data.hdr()->psize();
+	void work(){
+		while(true){
+			size_t index;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [this]{
+					return stopping || (nextToRead < paths.size() && nextToRead - nextToTake < depth);
+				});
+
+				if(stopping){
+					return;
+				}
 
-		for(auto &block : *data.blocks()){
-			if(block->code() != "DNA1"){
-				continue;
+				index = nextToRead++;
 			}
 
-			dna = &*block->body();
+			auto file = std::unique_ptr<ReadAheadFile>(new ReadAheadFile(paths.at(index)));
+			auto size = getFileSize(file->path);
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [this, index, size]{
+					return stopping || index == nextToTake || bytesReserved + bytesHandedOut + size <= memoryBudget;
+				});
 
-			for(int i = 0; i < dna->num_structs(); i++){
-				auto type = &*dna->structs()->at(i);
-				
-				typesByName[type->type()] = nullptr;
-				typesBySdnaIndex[i] = type->type();
-				sdnaIndexesByType[type->type()] = i;
+				if(stopping){
+					return;
+				}
+
+				bytesReserved += size;
+				file->reservedBytes = size;
 			}
 
-			for(int i = 0; i < dna->num_types(); i++){
-				auto name = dna->types()->at(i);
-				auto typeLength = dna->lengths()->at(i);
+			readFile(&*file);
 
-				typeLengths[name] = typeLength;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				ready[index] = std::move(file);
 			}
+			changed.notify_all();
 		}
 	}
 
-	int getTypeLength(std::string name){
-		if(!typeLengths.count(name)){
-			throw std::runtime_error(std::string("Could not find type ") + name);
-		}
-
-		return typeLengths[name];
-	}
+	public:
+	ReadAhead(std::vector<std::string> paths, unsigned int depth, size_t memoryBudget, unsigned int threads){
+		this->paths = paths;
+		this->depth = depth < 1 ? 1 : depth;
+		this->memoryBudget = memoryBudget;
 
-	BlendType* getType(int sdnaIndex){
-		if(!typesBySdnaIndex.count(sdnaIndex)){
-			char data[100];
-			sprintf(data, "Could not find type with SDNA index %i", sdnaIndex);
-			throw std::runtime_error(std::string(data));
+		if(threads < 1){
+			threads = 1;
 		}
 
-		auto name = typesBySdnaIndex.at(sdnaIndex);
-
-		return getType(name);
+		for(unsigned int i = 0; i < threads; i++){
+			workers.push_back(std::thread(&ReadAhead::work, this));
+		}
 	}
 
-	BlendType* getType(std::string name){
-		if(!typesByName.count(name)){
-			throw std::runtime_error(std::string("Could not find type ") + name);
+	~ReadAhead(){
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stopping = true;
 		}
+		changed.notify_all();
 
-		if(typesByName.at(name) != nullptr){
-			return typesByName.at(name);
+		for(auto &worker : workers){
+			worker.join();
 		}
+	}
 
-		int index = sdnaIndexesByType.at(name);
+	// Returns the next file in batch order, waiting for it to be read if needed. The
+	// memory of the previously returned file is given back to the budget.
+	std::unique_ptr<ReadAheadFile> next(){
+		std::unique_lock<std::mutex> lock(mutex);
 
-		auto sdna_struct = &*dna->structs()->at(index);
+		bytesHandedOut = 0;
+		changed.notify_all();
 
-		std::vector<BlendField*> fields;
-		int offset = 0;
-		for(auto &field : *sdna_struct->fields()){
-			auto fieldName = field->name();
-			auto fieldType = field->type();
-			int size;
-			int arraySize = 1;
+		if(nextToTake >= paths.size()){
+			return nullptr;
+		}
 
-			if(fieldName[0] == '*'){
-				size = pointerSize;
-			} else {
-				size = typeLengths[fieldType];
-			}
+		changed.wait(lock, [this]{
+			return ready.count(nextToTake) > 0;
+		});
 
-			int bracketPosition = fieldName.find('[');
+		auto file = std::move(ready.at(nextToTake));
+		ready.erase(nextToTake);
+		nextToTake++;
 
-			if(bracketPosition != -1){
-				int bracketEnd = fieldName.find(']');
+		bytesReserved -= file->reservedBytes;
+		bytesHandedOut = file->reservedBytes;
+		changed.notify_all();
 
-				if(bracketEnd == -1){
-					throw std::runtime_error(std::string("Array syntax was not name[length] - no end bracket"));
-				}
+		return file;
+	}
+};
 
-				arraySize = std::stoi(fieldName.substr(bracketPosition + 1, bracketEnd - bracketPosition));
+// Prints the first mesh of the file. Normals are computed from the geometry, as the
+// normals stored in MVert are missing from newer files and stale in many older ones.
+void convertMesh(BlockProvider &blockProvider, PointedDataProvider &pointedDataProvider){
+	auto part = blockProvider.getBlock("ME")->getPart();
+	auto mesh = MeshExtractor(&pointedDataProvider).extract(part);
+	NormalGenerator::generate(&*mesh);
 
-				if(bracketEnd != fieldName.length() - 1){
-					arraySize = 8*3; // multidimensional arrays are hardcoded as being [x][3] for now.
-					//throw std::runtime_error(std::string("Array syntax was not name[length] - something came after last bracket"));
-				}
+	printf("Converting mesh: %s\n", mesh->name.c_str());
 
+	printf("Total vertices: %i\n", mesh->getVertexCount());
+	printf("Total polys: %i\n", mesh->getPolyCount());
+	printf("Total loops: %i\n", mesh->getLoopCount());
 
-				fieldName = fieldName.substr(0, bracketPosition);
+	printf("Vertices:\n");
+	for(int i = 0; i < mesh->getVertexCount(); i++){
+		if(i){
+			printf("----------\n");
+		}
+		auto position = &mesh->positions[i * 3];
+		auto normal = &mesh->vertexNormals[i * 3];
+		printf("  Vertex:\n");
+		printf("    X: %0.10f\n", position[0]);
+		printf("    Y: %0.10f\n", position[1]);
+		printf("    Z: %0.10f\n", position[2]);
+		printf("  Normal:\n");
+		printf("    X: %0.6f\n", normal[0]);
+		printf("    Y: %0.6f\n", normal[1]);
+		printf("    Z: %0.6f\n", normal[2]);
+	}
+
+	printf("Polygons:\n");
+	for(int i = 0; i < mesh->getPolyCount(); i++){
+		if(i){
+			printf("-------------\n");
+		}
+		auto loopIndex = mesh->polyLoopStarts[i];
+		auto loopCount = mesh->polyLoopCounts[i];
+		printf("  Loop start: %i\n", loopIndex);
+		printf("  Loop count: %i\n", loopCount);
+		printf("  Points: ");
+		for(int j = loopIndex; j < loopIndex + loopCount; j++){
+			if(j > loopIndex){
+				printf(",");
+			}
+			printf("%i", mesh->loopVertices[j]);
+		}
+		printf("\n");
+		printf("  Texture coordinates: ");
+		for(int j = loopIndex; j < loopIndex + loopCount; j++){
+			if(j > loopIndex){
+				printf(",");
 			}
+			printf("%0.6f %0.6f", mesh->uvs[j * 2], mesh->uvs[j * 2 + 1]);
+		}
+		printf("\n");
+	}
+}
 
-			size *= arraySize;
+// Parses a conversion option at arguments[index], moving index past its value
+bool parseConvertOption(std::vector<std::string> &arguments, size_t &index, ConvertOptions &options){
+	auto argument = arguments.at(index);
 
-			fields.push_back(new BlendField(fieldName, fieldType, size, offset, arraySize));
+	if(argument == "--lod" && index + 1 < arguments.size()){
+		std::string counts = arguments.at(++index);
+		size_t start = 0;
 
-			offset += size;
+		while(start < counts.size()){
+			auto end = counts.find(',', start);
+			if(end == std::string::npos){
+				end = counts.size();
+			}
+			options.lodTriangleCounts.push_back(std::stoi(counts.substr(start, end - start)));
+			start = end + 1;
 		}
 
-		auto type = new BlendType(name, offset, fields);
+		return true;
+	}
+	if(argument == "--optimize-vertex-cache"){
+		options.optimizeVertexCache = true;
+		return true;
+	}
+	if(argument == "--normals"){
+		options.normals = true;
+		return true;
+	}
+	if(argument == "--animate"){
+		options.animate = true;
+		return true;
+	}
+	if(argument == "--no-modifiers"){
+		options.modifiers = false;
+		return true;
+	}
+	if(argument == "--unpack-textures"){
+		options.unpackTextures = true;
+		return true;
+	}
+	if(argument == "--atlas" && index + 1 < arguments.size()){
+		options.atlasSize = std::stoi(arguments.at(++index));
+		if(options.atlasSize <= 0){
+			throw std::runtime_error(std::string("Atlas page size must be positive: ") + arguments.at(index));
+		}
+		return true;
+	}
+	if(argument == "--frames" && index + 1 < arguments.size()){
+		std::string range = arguments.at(++index);
+		auto comma = range.find(',');
 
-		typesByName[type->name] = type;
+		if(comma == std::string::npos){
+			throw std::runtime_error(std::string("Frame range was not start,end: ") + range);
+		}
 
-		return type;
+		options.animate = true;
+		options.frameStart = std::stoi(range.substr(0, comma));
+		options.frameEnd = std::stoi(range.substr(comma + 1));
+		return true;
 	}
-};
+	if(argument == "--formats" && index + 1 < arguments.size()){
+		std::string formats = arguments.at(++index);
+		size_t start = 0;
+
+		options.formats.clear();
+		while(start < formats.size()){
+			auto end = formats.find(',', start);
+			if(end == std::string::npos){
+				end = formats.size();
+			}
 
-class DataSource {
-	private:
-	std::string raw_body;
-	public:
-	DataSource(std::string raw_body){
-		this->raw_body = raw_body;
+			auto format = formats.substr(start, end - start);
+			if(format != "pie" && format != "obj" && format != "gltf"){
+				throw std::runtime_error(std::string("Unknown output format: ") + format);
+			}
+			options.formats.push_back(format);
+			start = end + 1;
+		}
+
+		return true;
 	}
-	std::unique_ptr<kaitai::kstream> getStream(size_t offset){
-		auto stream = new kaitai::kstream(raw_body);
-		stream->seek(offset);
-		return std::unique_ptr<kaitai::kstream>(stream);
+	if(argument == "--transform" && index + 1 < arguments.size()){
+		options.transform = true;
+		options.transformScale = std::stof(arguments.at(++index));
+		return true;
 	}
-};
-
-class DataPart {
-	private:
-	TypeProvider *typeProvider;
-	DataSource *dataSource;
-	unsigned long long blockPosition;
-	size_t offset;
-	std::unique_ptr<kaitai::kstream> stream;
-
-	public:
-	BlendType *type;
-	DataPart(TypeProvider *typeProvider, DataSource *dataSource, unsigned long long blockPosition, size_t offset, BlendType *type){
-		this->typeProvider = typeProvider;
-		this->dataSource = dataSource;
-		this->blockPosition = blockPosition;
-		this->offset = offset;
-		this->stream = dataSource->getStream(offset);
-		this->type = type;
+	if(argument == "--quantize" && index + 1 < arguments.size()){
+		options.transform = true;
+		options.quantizeStep = std::stof(arguments.at(++index));
+		return true;
 	}
 
-	std::unique_ptr<DataPart> getPart(std::string name){
-		auto field = type->getField(name);
-		auto type = typeProvider->getType(field->type);
+	return false;
+}
 
-		return std::unique_ptr<DataPart>(new DataPart(typeProvider, dataSource, blockPosition, field->offset, type));
+// Converts one file of a batch: prints its first mesh, or writes its models to
+// outputDirectory when one is given
+bool convertBatchFile(BlendFile &blendFile, std::string outputDirectory, ConvertOptions &options){
+	if(outputDirectory.empty()){
+		BlockCache::Scope scope(blendFile.cache.get());
+		convertMesh(*blendFile.blockProvider, *blendFile.pointedDataProvider);
+		return true;
 	}
 
-	int32_t getInt(std::string name, unsigned int arrayIndex = 0){
-		auto field = type->getField(name);
+	auto name = getBaseName(blendFile.path);
+	name = name.substr(0, name.find_last_of('.'));
 
-		auto size = this->typeProvider->getTypeLength("int");
-		stream->seek(offset + field->offset + arrayIndex * size);
+	std::string atlasManifest;
+	auto path = outputDirectory + "/" + name + ".pie";
+	bool success;
+	options.atlasName = name + "-atlas";
 
-		if(size != 4){
-			char data[100];
-			sprintf(data, "Int sizes other than 4 bytes are not supported (was %i)", size);
-			throw std::runtime_error(std::string(data));
-		}
+	// Streamed files write each model as it is converted, instead of holding them all
+	if(blendFile.cache){
+		success = convertAndWriteModels(blendFile, options, path, &atlasManifest);
+	} else {
+		auto models = convertModels(blendFile, options, &atlasManifest);
+		success = writeModels(path, models);
+	}
 
-		return stream->read_s4le();
+	if(options.unpackTextures){
+		TextureUnpacker unpacker(&blendFile);
+		unpacker.verbose = options.verbose;
+		unpacker.unpack(outputDirectory);
 	}
 
-	int32_t getShort(std::string name, unsigned int arrayIndex = 0){
-		auto field = type->getField(name);
+	if(options.atlasSize && !writeFile(outputDirectory + "/" + options.atlasName + ".json", atlasManifest)){
+		printf("Error: Could not write %s/%s.json\n", outputDirectory.c_str(), options.atlasName.c_str());
+		return false;
+	}
 
-		auto size = this->typeProvider->getTypeLength("short");
-		stream->seek(offset + field->offset + arrayIndex * size);
+	return success;
+}
 
-		if(size != 2){
-			char data[100];
-			sprintf(data, "Short sizes other than 2 bytes are not supported (was %i)", size);
-			throw std::runtime_error(std::string(data));
+int runBatch(std::vector<std::string> arguments){
+	unsigned int depth = 4;
+	size_t memoryBudget = 256;
+	size_t streamMemoryBudget = 0; // bytes
+	unsigned int threads = 2;
+	std::string outputDirectory;
+	ConvertOptions options;
+	std::vector<std::string> paths;
+
+	for(size_t i = 2; i < arguments.size(); i++){
+		auto argument = arguments.at(i);
+
+		if(argument == "--read-ahead" && i + 1 < arguments.size()){
+			depth = std::stoi(arguments.at(++i));
+			continue;
+		}
+		if(argument == "--read-ahead-memory" && i + 1 < arguments.size()){
+			memoryBudget = std::stoul(arguments.at(++i));
+			continue;
+		}
+		if(argument == "--read-ahead-threads" && i + 1 < arguments.size()){
+			threads = std::stoi(arguments.at(++i));
+			continue;
+		}
+		if(argument == "--output" && i + 1 < arguments.size()){
+			outputDirectory = arguments.at(++i);
+			continue;
+		}
+		if(argument == "--stream" && i + 1 < arguments.size()){
+			streamMemoryBudget = std::stod(arguments.at(++i)) * 1024 * 1024;
+			continue;
+		}
+		if(parseConvertOption(arguments, i, options)){
+			continue;
 		}
 
-		return stream->read_s2le();
+		paths.push_back(argument);
 	}
 
-	float getFloat(std::string name, unsigned int arrayIndex = 0){
-		auto field = type->getField(name);
+	int failures = 0;
+
+	// Streamed files are read a block at a time as they are converted, so reading ahead
+	// whole files would defeat the memory budget
+	if(streamMemoryBudget){
+		for(auto &path : paths){
+			printf("File: %s\n", path.c_str());
+
+			try {
+				BlendFile blendFile(path, streamMemoryBudget);
 
-		auto size = this->typeProvider->getTypeLength("float");
-		stream->seek(offset + field->offset + arrayIndex * size);
+				if(!convertBatchFile(blendFile, outputDirectory, options)){
+					failures++;
+				}
 
-		if(size != 4){
-			char data[100];
-			sprintf(data, "Float sizes other than 4 bytes are not supported (was %i)", size);
-			throw std::runtime_error(std::string(data));
+				auto &cache = *blendFile.cache;
+				cache.printStatistics();
+				if(cache.getPeakSize() > cache.getMemoryBudget()){
+					printf("Warning: blocks in use at once took the block cache over its budget\n");
+				}
+			} catch(const std::exception &e) {
+				printf("Error: %s\n", e.what());
+				failures++;
+			}
 		}
 
-		return stream->read_f4le();
+		BlendFileCache::getShared().collect();
+
+		return failures ? 1 : 0;
 	}
 
-	std::string getString(std::string name){
-		auto field = type->getField(name);
+	ReadAhead readAhead(paths, depth, memoryBudget * 1024 * 1024, threads);
 
-		stream->seek(offset + field->offset);
-		return kaitai::kstream::bytes_to_str(stream->read_bytes(field->size), std::string("ASCII"));
-	}
+	while(auto file = readAhead.next()){
+		printf("File: %s\n", file->path.c_str());
 
-	unsigned long long getPointer(std::string name){
-		auto field = type->getField(name);
+		if(!file->error.empty()){
+			printf("Error: %s\n", file->error.c_str());
+			failures++;
+			continue;
+		}
 
-		stream->seek(offset + field->offset);
-		return readPointer(stream->read_bytes(typeProvider->pointerSize).c_str(), typeProvider->pointerSize);
-	}
-};
+		try {
+			BlendFile blendFile(file->path, file->contents);
 
-class DataBlock {
-	public:
-	std::unique_ptr<DataSource> dataSource;
-	std::unique_ptr<DataPart> part;
-	int index;
-	std::string code;
-	unsigned long long memaddr;
-	DataBlock(DataSource *dataSource, DataPart *part, unsigned int index, std::string code, unsigned long long memaddr){
-		this->dataSource = std::unique_ptr<DataSource>(dataSource);
-		this->part = std::unique_ptr<DataPart>(part);
-		this->index = index;
-		this->code = code;
-		this->memaddr = memaddr;
+			if(!convertBatchFile(blendFile, outputDirectory, options)){
+				failures++;
+			}
+		} catch(const std::exception &e) {
+			printf("Error: %s\n", e.what());
+			failures++;
+		}
 	}
-};
 
-class BlockItem {
-	public:
-	unsigned long long position;
-	unsigned int length;
-	unsigned int index;
-	std::string code;
-	blender_blend_t::file_block_t *block;
-
-	BlockItem(unsigned long long position, unsigned int length, unsigned int index, std::string code, blender_blend_t::file_block_t *block){
-		this->position = position;
-		this->length = length;
-		this->index = index;
-		this->code = code;
-		this->block = block;
-	}
-};
+	BlendFileCache::getShared().collect();
 
-bool blockItemComparer (const std::unique_ptr<BlockItem> &a, const std::unique_ptr<BlockItem> &b) {
-	return a->position < b->position;
+	return failures ? 1 : 0;
 }
 
-class BlockProvider {
-	private:
-	TypeProvider *typeProvider;
-	blender_blend_t *data;
+// Lists the .pie files under directory, as paths relative to it
+void findPieFiles(std::string directory, std::string prefix, std::vector<std::string> &result){
+	auto handle = opendir((directory + "/" + prefix).c_str());
+	if(handle == nullptr){
+		return;
+	}
 
-	public:
-	int pointerSize;
-	BlockProvider(TypeProvider *typeProvider, blender_blend_t &data){
-		this->typeProvider = typeProvider;
-		this->data = &data;
-		pointerSize = data.hdr()->psize();
+	while(auto entry = readdir(handle)){
+		std::string name = entry->d_name;
+		if(name == "." || name == ".."){
+			continue;
+		}
+
+		auto path = prefix.empty() ? name : prefix + "/" + name;
+		struct stat status;
+
+		if(stat((directory + "/" + path).c_str(), &status) != 0){
+			continue;
+		}
+		if(S_ISDIR(status.st_mode)){
+			findPieFiles(directory, path, result);
+		} else if(name.size() > 4 && strcasecmp(name.c_str() + name.size() - 4, ".pie") == 0){
+			result.push_back(path);
+		}
 	}
 
-	std::unique_ptr<DataBlock> getBlock(unsigned long long pointer){
-		int candidates = 0;
+	closedir(handle);
+}
 
-		auto blocks = std::vector<std::unique_ptr<BlockItem>>();
+// Compares converted models with reference models, either two files or every model of
+// a reference directory with the model at the same path under the converted directory
+int runValidate(std::vector<std::string> arguments){
+	float tolerance = 0.01f;
+	float uvTolerance = 0.005f;
+	std::vector<std::string> paths;
 
-		unsigned int index;
-		for(auto &block : *data->blocks()){
-			auto position = readPointer(block->mem_addr().c_str(), pointerSize);
+	for(size_t i = 2; i < arguments.size(); i++){
+		auto argument = arguments.at(i);
 
-			blocks.push_back(std::unique_ptr<BlockItem>(new BlockItem(position, block->len_body(), index++, std::string(block->code()), &*block)));
+		if(argument == "--tolerance" && i + 1 < arguments.size()){
+			tolerance = std::stof(arguments.at(++i));
+			continue;
+		}
+		if(argument == "--uv-tolerance" && i + 1 < arguments.size()){
+			uvTolerance = std::stof(arguments.at(++i));
+			continue;
 		}
 
-		std::sort (blocks.begin(), blocks.end(), blockItemComparer);
-
-		BlockItem *item = nullptr;
+		paths.push_back(argument);
+	}
 
-		for(const auto &block : blocks){
-			if(block->position == 0){
-				continue; // ENDB block does that, empty markers to signify EOF.
-			}
+	if(paths.size() != 2){
+		printf("Usage: blender-convert --validate [options] [reference] [converted]\n");
+		return 1;
+	}
 
-			auto blockEnd = block->position + block->length;
+	std::vector<std::string> names;
+	std::string referenceDirectory;
+	std::string convertedDirectory;
+	struct stat status;
+
+	if(stat(paths[0].c_str(), &status) == 0 && S_ISDIR(status.st_mode)){
+		referenceDirectory = paths[0] + "/";
+		convertedDirectory = paths[1] + "/";
+		findPieFiles(paths[0], "", names);
+		std::sort(names.begin(), names.end());
+	} else {
+		names.push_back("");
+		referenceDirectory = paths[0];
+		convertedDirectory = paths[1];
+	}
 
-			if(pointer < block->position){
-				continue;
-			}
-			if(pointer > blockEnd){
-				continue;
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::string> messages(names.size());
+	PieValidator validator(tolerance, uvTolerance);
+
+	parallelFor(names.size(), 1, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; i++){
+			try {
+				auto reference = PieReader(referenceDirectory + names[i]).read();
+				auto converted = PieReader(convertedDirectory + names[i]).read();
+				messages[i] = validator.compare(reference, converted);
+			} catch(const std::exception &e) {
+				messages[i] = e.what();
 			}
-
-			item = &*block;
-			candidates++;
 		}
+	});
 
-		if(candidates > 1){
-			char data[100];
-			sprintf(data, "Ambigious pointer reference - 0x%08llx resolves to multiple blocks", pointer);
-			throw std::runtime_error(std::string(data));
+	int failures = 0;
+	for(size_t i = 0; i < names.size(); i++){
+		if(!messages[i].empty()){
+			printf("FAIL %s: %s\n", names[i].empty() ? paths[1].c_str() : names[i].c_str(), messages[i].c_str());
+			failures++;
 		}
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	printf("Validated %i models in %0.2fs: %i passed, %i failed\n", (int)names.size(), elapsed.count(), (int)names.size() - failures, failures);
+
+	return failures ? 1 : 0;
+}
 
+// Answers the inspection commands that need no block bodies from the block index of
+// path, printing what the full parse would; false when the command is another one, or
+// the file has no current index
+bool inspectIndexed(std::vector<std::string> &arguments, std::string path){
+	static const std::set<std::string> commands = { "--list-header", "--list-blocks", "--list-block-with-code", "--list-types", "--list-structs", "--list-struct" };
 
-		auto type = typeProvider->getType(item->block->sdna_index());
-		auto dataSource = new DataSource(item->block->_raw_body());
-		auto part = new DataPart(typeProvider, dataSource, item->position, 0, type);
+	if(arguments.size() < 2 || arguments.size() > 3 || commands.count(arguments.at(1)) == 0){
+		return false;
+	}
 
-		return std::unique_ptr<DataBlock>(new DataBlock(dataSource, part, item->index, item->code, item->position));
+	BlockIndex index;
+	if(!index.read(path)){
+		return false;
 	}
 
-	std::unique_ptr<DataBlock> getBlock(std::string code){
-		if(code.length() == 2){
-			char codeChars[4] = {
-				code[0],
-				code[1],
-				'\0',
-				'\0',
-			};
-			code = std::string(codeChars, 4);
+	BlockScanner scanner(path, index);
+	auto command = arguments.at(1);
+	auto &dna = *scanner.dna;
+
+	if(arguments.size() == 2 && command == "--list-blocks"){
+		int i = 0;
+		for(auto &header : scanner.headers){
+			printf("%i: %s \n", i++, header.code.c_str());
 		}
-		if(code.length() == 3){
-			char codeChars[4] = {
-				code[0],
-				code[1],
-				code[2],
-				'\0',
-			};
-			code = std::string(codeChars, 4);
+	} else if(arguments.size() == 2 && command == "--list-header"){
+		printf("Blender version: %s \n", scanner.version.c_str());
+		printf("Pointer size: %i \n", scanner.pointerSize);
+		printf("Endianness: %s \n", scanner.endian == 'V' ? "BE" : "LE");
+	} else if(arguments.size() == 3 && command == "--list-block-with-code"){
+		auto code = arguments.at(2);
+		code.resize(4, '\0');
+
+		for(size_t i = 0; i < scanner.headers.size(); i++){
+			auto &header = scanner.headers[i];
+
+			if(header.code == code){
+				printf("[%i] 0x%08llx : %s\n", (int)i, header.memaddr, header.code.c_str());
+				return true;
+			}
 		}
 
-		int index;
+		printf("Not found\n");
+	} else if(arguments.size() == 2 && command == "--list-types"){
+		for(int i = 0; i < (int)dna.num_types(); i++){
+			printf("%s (%i)\n", dna.types()->at(i).c_str(), dna.lengths()->at(i));
+		}
+	} else if(command == "--list-structs" || command == "--list-struct"){
+		if(arguments.size() != (command == "--list-struct" ? 3u : 2u)){
+			return false;
+		}
 
-		for(auto &block : *data->blocks()){
-			if(block->code() != code){
-				index++;
+		for(auto &sdna_struct : *dna.structs()){
+			if(command == "--list-struct" && sdna_struct->type() != arguments.at(2)){
 				continue;
 			}
 
-			auto position = readPointer(block->mem_addr().c_str(), pointerSize);
-
-			auto type = typeProvider->getType(block->sdna_index());
-			auto dataSource = new DataSource(block->_raw_body());
-			auto part = new DataPart(typeProvider, dataSource, position, 0, type);
+			printf("%s\n", sdna_struct->type().c_str());
+			for(auto &field : *sdna_struct->fields()){
+				printf("  %s (%s)\n", field->name().c_str(), field->type().c_str());
+			}
+			printf("\n");
 
-			return std::unique_ptr<DataBlock>(new DataBlock(dataSource, part, index, std::string(block->code()), position));
+			if(command == "--list-struct"){
+				return true;
+			}
 		}
 
-		throw std::runtime_error(std::string("Could not find block ") + code);
+		if(command == "--list-struct"){
+			printf("Not found\n");
+		}
+	} else {
+		return false;
 	}
-};
 
-class PointedDataProvider {
-	private:
-	TypeProvider *typeProvider;
-	BlockProvider *blockProvider;
-	public:
-	PointedDataProvider(TypeProvider *typeProvider, BlockProvider *blockProvider){
-		this->typeProvider = typeProvider;
-		this->blockProvider = blockProvider;
-	}
-	std::unique_ptr<DataPart> getPointedData(DataPart *dataPart, std::string name, unsigned int arrayIndex = 0){
-		auto pointer = dataPart->getPointer(name);
-		auto block = blockProvider->getBlock(pointer);
-		auto field = dataPart->type->getField(name);
-		auto fieldType = typeProvider->getType(field->type);
+	return true;
+}
 
-		return std::unique_ptr<DataPart>(new DataPart(typeProvider, &*block->dataSource, block->memaddr, pointer - block->memaddr + fieldType->size * arrayIndex, fieldType));
+int run(std::vector<std::string> arguments){
+	if(arguments.size() >= 2 && arguments.at(1) == "--batch"){
+		return runBatch(arguments);
+	}
+	if(arguments.size() >= 2 && arguments.at(1) == "--validate"){
+		return runValidate(arguments);
 	}
-};
 
-int main(int argc, char **argv) {
-	std::vector<std::string> arguments;
-	for(int i = 0; i < argc; i++){
-		arguments.push_back(argv[i]);
+	std::string path = "/home/bjorn/Desktop/blender-convert/cube.blend";
+
+	// The file comes before the command, as in the usage below
+	if(arguments.size() >= 2 && arguments.at(1).compare(0, 2, "--") != 0){
+		path = arguments.at(1);
+		arguments.erase(arguments.begin() + 1);
 	}
 
-	std::ifstream is("/home/bjorn/Desktop/blender-convert/cube.blend", std::ifstream::binary);
-	kaitai::kstream ks(&is);
-	blender_blend_t data(&ks);
+	if(arguments.size() == 2 && arguments.at(1) == "--build-index"){
+		auto index = BlockScanner(path).getIndex();
+
+		if(!index.write(path)){
+			printf("Could not write %s\n", BlockIndex::getPath(path).c_str());
+			return 1;
+		}
+
+		printf("Indexed %i blocks in %s\n", (int)index.headers.size(), BlockIndex::getPath(path).c_str());
+		return 0;
+	}
+	if(inspectIndexed(arguments, path)){
+		return 0;
+	}
 
-	TypeProvider typeProvider(data);
-	BlockProvider blockProvider(&typeProvider, data);
-	PointedDataProvider pointedDataProvider(&typeProvider, &blockProvider);
+	BlendFile file(path);
+	auto &data = *file.data;
+	auto &blockProvider = *file.blockProvider;
+	auto &pointedDataProvider = *file.pointedDataProvider;
 
 	if(arguments.size() == 2 && arguments.at(1) == "--help"){
 		printf("Usage:\n");
@@ -490,6 +1729,35 @@ int main(int argc, char **argv) {
 		printf("  blender-convert [file] --list-types           // lists all types\n");
 		printf("  blender-convert [file] --list-structs         // lists all structs\n");
 		printf("  blender-convert [file] --list-struct [type]   // lists a specific struct\n");
+		printf("  blender-convert [file] --list-objects         // lists the objects of every view layer\n");
+		printf("  blender-convert [file] --list-links           // lists linked libraries and IDs\n");
+		printf("  blender-convert [file] --build-index          // writes a .blendidx block index, used by later listings\n");
+		printf("  blender-convert [file] --dump [json|binary] [output] // decodes every block, to stdout by default\n");
+		printf("  blender-convert [file] --to-pie [output] [options] // converts the meshes to PIE models\n");
+		printf("  blender-convert --batch [options] [files...]  // converts several files, reading ahead\n");
+		printf("    --output [directory]                        // writes PIE models here instead of listing meshes\n");
+		printf("    --read-ahead [count]                        // files read ahead of the current one (default 4)\n");
+		printf("    --read-ahead-memory [MB]                    // memory budget for files read ahead (default 256)\n");
+		printf("    --read-ahead-threads [count]                // reader threads (default 2)\n");
+		printf("    --stream [MB]                               // reads blocks on demand, keeping about this much of each file and library in memory\n");
+		printf("  blender-convert --validate [options] [reference] [converted] // compares PIE models, or directories of them\n");
+		printf("    --tolerance [distance]                      // largest position difference (default 0.01)\n");
+		printf("    --uv-tolerance [distance]                   // largest texture coordinate difference (default 0.005)\n");
+		printf("  Conversion options:\n");
+		printf("    --lod [triangles,...]                       // adds a simplified level per target triangle count\n");
+		printf("    --optimize-vertex-cache                     // reorders triangles and points for the vertex cache\n");
+		printf("    --normals                                   // writes PIE 4 with normals, split at sharp edges\n");
+		printf("    --animate                                   // adds object animation over the scene's frame range\n");
+		printf("    --no-modifiers                              // leaves out Mirror and Array modifiers, which are applied by default\n");
+		printf("    --frames [start,end]                        // adds object animation over these frames\n");
+		printf("    --unpack-textures                           // writes packed images next to the models\n");
+		printf("    --formats [pie,obj,gltf]                    // writes each model in these formats from one extraction\n");
+		printf("    --transform [scale]                         // applies the object matrix and turns Z-up into Y-up, in game units per meter\n");
+		printf("    --quantize [step]                           // snaps transformed positions to a grid of this size\n");
+		printf("    --atlas [size]                              // packs the images of all meshes into shared pages of this size, listed in [name]-atlas.json\n");
+		printf("  Memory options, with any command:\n");
+		printf("    --memory-report                             // prints live and peak memory per subsystem at exit\n");
+		printf("    --memory-limit [ratio]                      // fails when peak memory per input MB is above ratio\n");
 
 		return 0;
 	}
@@ -568,55 +1836,144 @@ int main(int argc, char **argv) {
 		return 0;
 	}
 
-	//
+	if(arguments.size() == 2 && arguments.at(1) == "--list-objects"){
+		for(auto scene : blockProvider.getBlocks("SC")){
+			printf("%s\n", scene->part.getString("id.name").c_str() + 2);
+
+			for(auto viewLayer : pointedDataProvider.getList(scene->part, "view_layers")){
+				printf("  %s\n", viewLayer.getString("name").c_str());
 
-	std::unique_ptr<DataBlock> mesh = blockProvider.getBlock("ME");
+				for(auto base : pointedDataProvider.getList(viewLayer, "object_bases")){
+					auto object = pointedDataProvider.getPointedData(base, "*object");
+					printf("    %s\n", object.getString("id.name").c_str() + 2);
+				}
+			}
+		}
 
-	printf("Converting mesh: %s\n", mesh->part->getPart("id")->getString("name").c_str());
+		return 0;
+	}
+	if(arguments.size() == 2 && arguments.at(1) == "--list-links"){
+		LibraryLinker linker(&file, &BlendFileCache::getShared());
 
-	auto vertexCount = mesh->part->getInt("totvert");
-	printf("Total vertices: %i\n", vertexCount);
-	auto polygonCount = mesh->part->getInt("totpoly");
-	printf("Total polys: %i\n", polygonCount);
-	printf("Total loops: %i\n", mesh->part->getInt("totloop"));
+		for(auto library : blockProvider.getBlocks("LI")){
+			printf("%s\n", linker.getLibraryPath(library->part).c_str());
+		}
 
-	printf("Vertices:\n");
-	for(int i = 0; i < vertexCount; i++){
-		if(i){
-			printf("----------\n");
+		for(auto code : { "ME", "MA" }){
+			for(auto placeholder : linker.getLinkedIds(code)){
+				printf("  %s: ", placeholder->part.getString("name").c_str() + 2);
+
+				try {
+					auto linked = linker.resolve(placeholder);
+					printf("[%i] in %s\n", linked.block->index, linked.file->path.c_str());
+				} catch(const std::exception &e) {
+					printf("%s\n", e.what());
+				}
+			}
 		}
-		auto mvert = pointedDataProvider.getPointedData(&*mesh->part, "*mvert", i);
-		printf("  Vertex:\n");
-		printf("    X: %0.10f\n", mvert->getFloat("co", 0));
-		printf("    Y: %0.10f\n", mvert->getFloat("co", 1));
-		printf("    Z: %0.10f\n", mvert->getFloat("co", 2));
-		printf("  Normal:\n");
-		printf("    X: %i\n", mvert->getShort("no", 0));
-		printf("    Y: %i\n", mvert->getShort("no", 1));
-		printf("    Z: %i\n", mvert->getShort("no", 2));
+
+		return 0;
 	}
+	if(arguments.size() >= 3 && arguments.size() <= 4 && arguments.at(1) == "--dump"){
+		auto format = arguments.at(2);
 
-	printf("Polygons:\n");
-	for(int i = 0; i < polygonCount; i++){
-		if(i){
-			printf("-------------\n");
+		// Checked first, so a mistyped format does not truncate the output file
+		if(format != "json" && format != "binary"){
+			printf("Unknown dump format %s\n", format.c_str());
+			return 1;
 		}
-		auto mpoly = pointedDataProvider.getPointedData(&*mesh->part, "*mpoly", i);
-		auto loopIndex = mpoly->getInt("loopstart");
-		auto loopCount = mpoly->getInt("totloop");
-		printf("  Loop start: %i\n", loopIndex);
-		printf("  Loop count: %i\n", loopCount);
-		printf("  Points: ");
-		for(int j = loopIndex; j < loopIndex + loopCount; j++){
-			if(j > loopIndex){
-				printf(",");
+
+		FILE *output = arguments.size() == 4 ? fopen(arguments.at(3).c_str(), "wb") : stdout;
+
+		if(output == nullptr){
+			printf("Could not write %s\n", arguments.at(3).c_str());
+			return 1;
+		}
+
+		{
+			MemoryScope scope(MEMORY_OUTPUT);
+			BufferedWriter writer(output);
+			JsonDumpWriter jsonWriter(&writer);
+			BinaryDumpWriter binaryWriter(&writer);
+			DumpWriter *dumpWriter = format == "json" ? (DumpWriter*)&jsonWriter : (DumpWriter*)&binaryWriter;
+
+			FileDumper(file.typeProvider.get(), &blockProvider, dumpWriter).dump(data.hdr()->version());
+		}
+
+		if(output != stdout){
+			fclose(output);
+		}
+
+		return 0;
+	}
+	if(arguments.size() >= 3 && arguments.at(1) == "--to-pie"){
+		ConvertOptions options;
+
+		for(size_t i = 3; i < arguments.size(); i++){
+			if(!parseConvertOption(arguments, i, options)){
+				printf("Unknown option %s\n", arguments.at(i).c_str());
+				return 1;
 			}
-			auto mloop = pointedDataProvider.getPointedData(&*mesh->part, "*mloop", j);
-			auto vertexIndex = mloop->getInt("v");
-			printf("%i", vertexIndex);
 		}
-		printf("\n");
+
+		auto output = arguments.at(2);
+		auto slash = output.find_last_of('/');
+		auto directory = slash == std::string::npos ? std::string(".") : output.substr(0, slash);
+		auto name = getBaseName(output);
+
+		std::string atlasManifest;
+		options.atlasName = name.substr(0, name.find_last_of('.')) + "-atlas";
+		auto models = convertModels(file, options, &atlasManifest);
+
+		if(options.unpackTextures){
+			TextureUnpacker(&file).unpack(directory);
+		}
+
+		if(options.atlasSize && !writeFile(directory + "/" + options.atlasName + ".json", atlasManifest)){
+			printf("Error: Could not write %s/%s.json\n", directory.c_str(), options.atlasName.c_str());
+			return 1;
+		}
+
+		return writeModels(arguments.at(2), models) ? 0 : 1;
 	}
 
+	//
+
+	convertMesh(blockProvider, pointedDataProvider);
+
 	return 0;
 }
+
+// Memory options go anywhere on the command line; the rest is left to run()
+int main(int argc, char **argv) {
+	std::vector<std::string> arguments;
+	bool memoryReport = false;
+	double memoryLimit = 0; // peak MB per input MB, 0 for none
+
+	for(int i = 0; i < argc; i++){
+		std::string argument = argv[i];
+
+		if(argument == "--memory-report"){
+			memoryReport = true;
+			continue;
+		}
+		if(argument == "--memory-limit" && i + 1 < argc){
+			memoryLimit = std::stod(argv[++i]);
+			continue;
+		}
+
+		arguments.push_back(argument);
+	}
+
+	auto result = run(arguments);
+
+	if(memoryReport){
+		MemoryTracker::printReport();
+	}
+	if(memoryLimit > 0 && MemoryTracker::getPeakPerInput() > memoryLimit){
+		printf("Error: peak memory of %0.2f MB per input MB is over the limit of %0.2f\n", MemoryTracker::getPeakPerInput(), memoryLimit);
+		return result ? result : 1;
+	}
+
+	return result;
+}
@@ -0,0 +1,45 @@
+# Checks --validate on a conversion of FILE in WORK: the model matches itself and a copy
+# with one point moved within --tolerance, and fails against a copy with that point moved
+# beyond it.
+#
+#   cmake -DCONVERT=blender-convert -DFILE=cube.blend -DWORK=dir -P validate_test.cmake
+
+set (REFERENCE ${WORK}/validate-test.pie)
+set (TOLERANCE 0.1)
+
+# Fails unless validating converted against the reference exits with expected
+function(validate converted expected)
+	execute_process(COMMAND ${CONVERT} --validate --tolerance ${TOLERANCE} ${REFERENCE} ${converted} RESULT_VARIABLE result OUTPUT_VARIABLE text)
+
+	if(NOT result EQUAL expected)
+		message(FATAL_ERROR "--validate of ${converted} exited with ${result}, expected ${expected}:\n${text}")
+	endif()
+endfunction()
+
+# Writes the reference with the x of its first point replaced by x
+function(move_point converted x)
+	file(READ ${REFERENCE} model)
+	string(REGEX REPLACE "(POINTS [0-9]+\n\t)[^ ]+" "\\1${x}" model "${model}")
+	file(WRITE ${converted} "${model}")
+endfunction()
+
+execute_process(COMMAND ${CONVERT} ${FILE} --to-pie ${REFERENCE} RESULT_VARIABLE result OUTPUT_VARIABLE text)
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "--to-pie failed:\n${text}")
+endif()
+
+file(READ ${REFERENCE} model)
+if(NOT model MATCHES "POINTS [0-9]+\n\t(-?[0-9]+) ")
+	message(FATAL_ERROR "The first point of ${REFERENCE} has no whole x")
+endif()
+set (x ${CMAKE_MATCH_1})
+
+validate(${REFERENCE} 0)
+
+move_point(${WORK}/validate-test-within.pie ${x}.05)
+validate(${WORK}/validate-test-within.pie 0)
+
+move_point(${WORK}/validate-test-beyond.pie ${x}.5)
+validate(${WORK}/validate-test-beyond.pie 1)
+
+message("Validation checks passed")